@@ -1,7 +1,10 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <cassert>
 #include <string.h>
 #include <inttypes.h>
+#include <math.h>
+#include <immintrin.h>
 
 using namespace std;
 
@@ -12,19 +15,30 @@ using namespace std;
 /*
 # Seperate Predictor Types
 
-In each function (mainly PredictorReset() and PredictorRunACycle()
-there will be a if-else statement that switches between the different
-types of predictor. Code specific to each type of predictor should
-be implemented in the branch of the if-else statement corresponding
-to the specific type of branch predictor. In general,
+Each predictor is a predictor_component (see predictor.h). PredictorReset()
+builds the component for the current run and PredictorRunACycle() asks it
+for a prediction at fetch and trains it at retire. By default,
 
 - the predictor will use saturating-counter in the first run,
-- the gselect predictor will be used in the second run, and
-- the gshare predictor will be used in the third run.
+- the gselect predictor will be used in the second run,
+- the gshare predictor will be used in the third run,
+- the TAGE predictor will be used in the fourth run,
+- the perceptron predictor will be used in the fifth run, and
+- the 2-bit/gshare tournament will be used in the sixth run.
+
+The run order and the table geometry can be changed at start-up with a
+BP_CONFIG file, see predictor_config.
+
+# Single pass
+
+With single_pass set, every configured predictor is built for one run and
+sees the same fetch/retire stream, each with its own history registers.
+Only the first one reports predictions to the framework, so it alone
+shapes the pipeline and the framework's penalty-weighted MPPKI; every
+predictor's own mispredictions are counted at fetch and printed as MPKI at
+the end of the run. The trace is decoded once instead of once per
+predictor.
 */
-#define TWO_BIT_PREDICTOR_ 0U
-#define GSELECT_PREDICTOR_ 1U
-#define GSHARE_PREDICTOR_  2U
 
 /*
 # Two branch history registers
@@ -35,50 +49,651 @@ in a real machine. therefore, you can only use them to update predictors at or a
 branch is executed.
 */
 
-// cost: depending on predictor size
-uint32_t brh_fetch;
-uint32_t brh_retire;
+// A predictor being evaluated, with its own branch history registers
+struct predictor_slot {
+    predictor_component *pred;
+    // cost: depending on predictor size
+    uint32_t brh_fetch;
+    uint32_t brh_retire;
+    uint64_t mispredicts; // counted at fetch
+};
 
 // Count number of runs, this is used to switch between
 // the different predictors.
 uint32_t runs;
 
+// Geometry and run order, fixed after PredictorInit()
+predictor_config config;
+
+// Predictors of the current run, slots[0] drives the pipeline
+predictor_slot slots[MAX_RUNS];
+uint32_t num_slots;
+
+// Instructions retired in the current run
+uint64_t retired_insts;
+
+static const char *predictor_names[NUM_PREDICTORS_] = {
+    "2bit", "gselect", "gshare", "tage", "perceptron", "tournament"
+};
+
+static bool is_pow2(uint32_t x) {
+    return x != 0 && (x & (x - 1)) == 0;
+}
+
+static uint32_t table_entries(uint32_t entries, uint32_t bits) {
+    return entries ? entries : 1U << bits;
+}
+
+predictor_component *make_predictor(uint32_t kind, const predictor_config &cfg) {
+    uint32_t n;
+    switch (kind) {
+    case TWO_BIT_PREDICTOR_:
+        n = table_entries(cfg.b2_entries, cfg.b2_addr_bits);
+        if (is_pow2(n)) return new bimodal_predictor<true>(cfg);
+        return new bimodal_predictor<false>(cfg);
+    case GSELECT_PREDICTOR_:
+        n = table_entries(cfg.gsel_entries, cfg.gsel_addr_bits + cfg.gsel_his_bits);
+        if (is_pow2(n)) return new gselect_predictor<true>(cfg);
+        return new gselect_predictor<false>(cfg);
+    case GSHARE_PREDICTOR_:
+        n = table_entries(cfg.gshare_entries, cfg.gshare_addr_bits > cfg.gshare_his_bits
+                                              ? cfg.gshare_addr_bits : cfg.gshare_his_bits);
+        if (is_pow2(n)) return new gshare_predictor<true>(cfg);
+        return new gshare_predictor<false>(cfg);
+    case TAGE_PREDICTOR_:
+        return new tage_predictor(cfg);
+    case PERCEPTRON_PREDICTOR_:
+        return new perceptron_predictor(cfg);
+    case TOURNAMENT_PREDICTOR_:
+        return new tournament_predictor(cfg);
+    }
+    return NULL;
+}
+
+static void default_config(predictor_config &cfg) {
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.runs[0] = TWO_BIT_PREDICTOR_;
+    cfg.runs[1] = GSELECT_PREDICTOR_;
+    cfg.runs[2] = GSHARE_PREDICTOR_;
+    cfg.runs[3] = TAGE_PREDICTOR_;
+    cfg.runs[4] = PERCEPTRON_PREDICTOR_;
+    cfg.runs[5] = TOURNAMENT_PREDICTOR_;
+    cfg.num_runs = 6;
+    cfg.b2_addr_bits = B2_ADDR_BITS;
+    cfg.gshare_addr_bits = G_SHARE_ADDR_BITS;
+    cfg.gshare_his_bits = G_SHARE_HIS_BITS;
+    cfg.gsel_addr_bits = G_SEL_ADDR_BITS;
+    cfg.gsel_his_bits = G_SEL_HIS_BITS;
+    cfg.tage_base_bits = TAGE_BASE_BITS;
+    cfg.tage_tables = TAGE_TABLES;
+    cfg.tage_log_entries = TAGE_LOG_ENTRIES;
+    cfg.tage_tag_bits = TAGE_TAG_BITS;
+    cfg.tage_min_hist = TAGE_MIN_HIST;
+    cfg.tage_max_hist = TAGE_MAX_HIST;
+    cfg.perc_segments = PERC_SEGMENTS;
+    cfg.perc_log_rows = PERC_LOG_ROWS;
+    cfg.perc_simd = PERC_SIMD_AUTO;
+    cfg.tour_chooser_bits = TOUR_CHOOSER_BITS;
+}
+
+// Parse "2bit gselect ..." into the run order
+static bool parse_runs(char *value, predictor_config &cfg) {
+    uint32_t n = 0;
+    for (char *tok = strtok(value, " \t,"); tok; tok = strtok(NULL, " \t,")) {
+        uint32_t kind;
+        for (kind = 0; kind < NUM_PREDICTORS_; kind++)
+            if (strcmp(tok, predictor_names[kind]) == 0) break;
+        if (kind == NUM_PREDICTORS_ || n == MAX_RUNS) return false;
+        cfg.runs[n++] = kind;
+    }
+    if (n == 0) return false;
+    cfg.num_runs = n;
+    return true;
+}
+
+// Read "key = value" lines from path into cfg, warning about bad lines
+static void read_config(const char *path, predictor_config &cfg) {
+    struct { const char *key; uint32_t *val; uint32_t max; } keys[] = {
+        { "single_pass",      &cfg.single_pass,      1 },
+        { "b2_addr_bits",     &cfg.b2_addr_bits,     28 },
+        { "b2_entries",       &cfg.b2_entries,       1U << 28 },
+        { "gshare_addr_bits", &cfg.gshare_addr_bits, 28 },
+        { "gshare_his_bits",  &cfg.gshare_his_bits,  28 },
+        { "gshare_entries",   &cfg.gshare_entries,   1U << 28 },
+        { "gsel_addr_bits",   &cfg.gsel_addr_bits,   28 },
+        { "gsel_his_bits",    &cfg.gsel_his_bits,    28 },
+        { "gsel_entries",     &cfg.gsel_entries,     1U << 28 },
+        { "tage_base_bits",   &cfg.tage_base_bits,   28 },
+        { "tage_tables",      &cfg.tage_tables,      TAGE_MAX_TABLES },
+        { "tage_log_entries", &cfg.tage_log_entries, 24 },
+        { "tage_tag_bits",    &cfg.tage_tag_bits,    16 },
+        { "tage_min_hist",    &cfg.tage_min_hist,    1U << 16 },
+        { "tage_max_hist",    &cfg.tage_max_hist,    1U << 16 },
+        { "perc_segments",    &cfg.perc_segments,    PERC_MAX_SEGMENTS },
+        { "perc_log_rows",    &cfg.perc_log_rows,    24 },
+        { "perc_theta",       &cfg.perc_theta,       1U << 16 },
+        { "perc_simd",        &cfg.perc_simd,        PERC_SIMD_AUTO },
+        { "tour_chooser_bits", &cfg.tour_chooser_bits, 28 },
+    };
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        fprintf(stderr, "BP_CONFIG: cannot open %s, using defaults\n", path);
+        return;
+    }
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *p = strchr(line, '#');
+        if (p) *p = '\0';
+        char key[64], value[192];
+        value[0] = '\0';
+        if (sscanf(line, " %63[A-Za-z0-9_] = %191[^\n]", key, value) < 1) continue;
+
+        bool ok = false;
+        if (strcmp(key, "predictors") == 0) {
+            ok = parse_runs(value, cfg);
+        } else {
+            for (size_t k = 0; k < sizeof(keys) / sizeof(keys[0]); k++) {
+                if (strcmp(key, keys[k].key) != 0) continue;
+                char *end;
+                unsigned long v = strtoul(value, &end, 0);
+                if (end != value && v <= keys[k].max) {
+                    *keys[k].val = (uint32_t) v;
+                    ok = true;
+                }
+                break;
+            }
+        }
+        if (!ok)
+            fprintf(stderr, "BP_CONFIG: %s:%d: ignoring \"%s\"\n", path, lineno, key);
+    }
+    fclose(fp);
+
+    // gselect concatenates its address and history bits into one index
+    if (cfg.gsel_addr_bits + cfg.gsel_his_bits > 28) {
+        fprintf(stderr, "BP_CONFIG: gselect index wider than 28 bits, using defaults\n");
+        cfg.gsel_addr_bits = G_SEL_ADDR_BITS;
+        cfg.gsel_his_bits = G_SEL_HIS_BITS;
+    }
+    if (cfg.tage_tables == 0 || cfg.tage_tag_bits < 4 || cfg.tage_log_entries == 0 ||
+        cfg.tage_min_hist == 0 || cfg.tage_max_hist < cfg.tage_min_hist) {
+        fprintf(stderr, "BP_CONFIG: bad TAGE geometry, using defaults\n");
+        cfg.tage_tables = TAGE_TABLES;
+        cfg.tage_log_entries = TAGE_LOG_ENTRIES;
+        cfg.tage_tag_bits = TAGE_TAG_BITS;
+        cfg.tage_min_hist = TAGE_MIN_HIST;
+        cfg.tage_max_hist = TAGE_MAX_HIST;
+    }
+    if (cfg.perc_segments == 0) {
+        fprintf(stderr, "BP_CONFIG: perceptron needs a history segment, using defaults\n");
+        cfg.perc_segments = PERC_SEGMENTS;
+    }
+    // Rows are folded in steps of log_rows bits
+    if (cfg.perc_log_rows == 0) {
+        fprintf(stderr, "BP_CONFIG: perceptron needs at least 2 rows, using defaults\n");
+        cfg.perc_log_rows = PERC_LOG_ROWS;
+    }
+}
+
+// ------ TAGE -------//
+
+void tage_history::init(uint32_t n, const uint32_t *hist_len, uint32_t log_entries, uint32_t tag_bits) {
+    uint32_t size = 1;
+    while (size <= hist_len[n - 1]) size <<= 1;
+    bits.assign(size, 0);
+    ptr = 0;
+    mask = size - 1;
+    tables = n;
+    length = hist_len;
+    for (uint32_t i = 0; i < n; i++) {
+        index[i].init(hist_len[i], log_entries);
+        tag[0][i].init(hist_len[i], tag_bits);
+        tag[1][i].init(hist_len[i], tag_bits - 1);
+    }
+}
+
+void tage_history::push(bool taken) {
+    ptr = (ptr - 1) & mask;
+    bits[ptr] = taken;
+    for (uint32_t i = 0; i < tables; i++) {
+        uint32_t oldest = bits[(ptr + length[i]) & mask];
+        index[i].update(taken, oldest);
+        tag[0][i].update(taken, oldest);
+        tag[1][i].update(taken, oldest);
+    }
+}
+
+tage_predictor::tage_predictor(const predictor_config &cfg)
+    : tables(cfg.tage_tables), log_entries(cfg.tage_log_entries), tag_bits(cfg.tage_tag_bits),
+      use_alt_on_na(0), tick(0), seed(0x2545f491) {
+    // Geometric series from min to max history
+    for (uint32_t i = 0; i < tables; i++) {
+        double ratio = tables > 1 ? (double) i / (tables - 1) : 0.0;
+        hist_len[i] = (uint32_t) (cfg.tage_min_hist *
+                                  pow((double) cfg.tage_max_hist / cfg.tage_min_hist, ratio) + 0.5);
+        if (i > 0 && hist_len[i] <= hist_len[i - 1])
+            hist_len[i] = hist_len[i - 1] + 1;
+        entry e = { 0, 0, 0 };
+        table[i].assign(1U << log_entries, e);
+    }
+    base.init(1U << cfg.tage_base_bits, COUNTER_INIT + 1); // weakly taken
+    fetch_hist.init(tables, hist_len, log_entries, tag_bits);
+    retire_hist.init(tables, hist_len, log_entries, tag_bits);
+}
+
+uint32_t tage_predictor::random() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+void tage_predictor::find(uint32_t pc, const tage_history &h, lookup &l) const {
+    uint32_t imask = (1U << log_entries) - 1;
+    uint32_t tmask = (1U << tag_bits) - 1;
+    for (uint32_t i = 0; i < tables; i++) {
+        l.index[i] = (pc ^ (pc >> (log_entries - i % log_entries)) ^ h.index[i].comp) & imask;
+        l.tag[i] = (uint16_t) ((pc ^ h.tag[0][i].comp ^ (h.tag[1][i].comp << 1)) & tmask);
+    }
+
+    // Longest matching table provides, the next longest is the alternate
+    l.provider = l.alt = -1;
+    for (int i = (int) tables - 1; i >= 0; i--) {
+        if (table[i][l.index[i]].tag != l.tag[i]) continue;
+        if (l.provider < 0) {
+            l.provider = i;
+        } else {
+            l.alt = i;
+            break;
+        }
+    }
+    bool base_pred = base.predict(pc);
+    l.alt_pred = l.alt >= 0 ? table[l.alt][l.index[l.alt]].ctr >= 0 : base_pred;
+    if (l.provider < 0) {
+        l.provider_pred = l.pred = base_pred;
+        return;
+    }
+    const entry &e = table[l.provider][l.index[l.provider]];
+    l.provider_pred = e.ctr >= 0;
+    // A newly allocated entry (weak counter, not yet useful) is often
+    // worse than the alternate
+    bool weak = (e.ctr == 0 || e.ctr == -1) && e.u == 0;
+    l.pred = weak && use_alt_on_na >= 0 ? l.alt_pred : l.provider_pred;
+}
+
+void tage_predictor::allocate(const lookup &l, bool taken) {
+    // Take one free entry in a longer table, usually the shortest one
+    int start = l.provider + 1;
+    if (start < (int) tables - 1 && (random() & 3) == 0)
+        start++;
+    for (int i = start; i < (int) tables; i++) {
+        entry &e = table[i][l.index[i]];
+        if (e.u == 0) {
+            e.tag = l.tag[i];
+            e.ctr = taken ? 0 : -1;
+            return;
+        }
+    }
+    // None free: make room for next time
+    for (int i = l.provider + 1; i < (int) tables; i++) {
+        entry &e = table[i][l.index[i]];
+        if (e.u > 0) e.u--;
+    }
+}
+
+// Halve every useful counter so entries that stopped helping can be replaced
+void tage_predictor::age() {
+    for (uint32_t i = 0; i < tables; i++)
+        for (size_t k = 0; k < table[i].size(); k++)
+            table[i][k].u >>= 1;
+}
+
+bool tage_predictor::predict(uint32_t pc, uint32_t) {
+    lookup l;
+    find(pc, fetch_hist, l);
+    return l.pred;
+}
+
+void tage_predictor::update(uint32_t pc, uint32_t, bool taken) {
+    // Recompute the lookup with the history the branch was fetched with
+    lookup l;
+    find(pc, retire_hist, l);
+
+    if (l.provider >= 0) {
+        entry &e = table[l.provider][l.index[l.provider]];
+        bool weak = (e.ctr == 0 || e.ctr == -1) && e.u == 0;
+        if (weak && l.provider_pred != l.alt_pred) {
+            if (l.alt_pred == taken) {
+                if (use_alt_on_na < 7) use_alt_on_na++;
+            } else {
+                if (use_alt_on_na > -8) use_alt_on_na--;
+            }
+        }
+    }
+
+    if (l.pred != taken && l.provider < (int) tables - 1)
+        allocate(l, taken);
+
+    if (l.provider >= 0) {
+        entry &e = table[l.provider][l.index[l.provider]];
+        if (taken) {
+            if (e.ctr < 3) e.ctr++;
+        } else {
+            if (e.ctr > -4) e.ctr--;
+        }
+        // Until the provider has proved useful, train the alternate too
+        if (e.u == 0) {
+            if (l.alt >= 0) {
+                entry &a = table[l.alt][l.index[l.alt]];
+                if (taken) {
+                    if (a.ctr < 3) a.ctr++;
+                } else {
+                    if (a.ctr > -4) a.ctr--;
+                }
+            } else {
+                base.update(pc, taken);
+            }
+        }
+        if (l.provider_pred != l.alt_pred) {
+            if (l.provider_pred == taken) {
+                if (e.u < 3) e.u++;
+            } else {
+                if (e.u > 0) e.u--;
+            }
+        }
+    } else {
+        base.update(pc, taken);
+    }
+
+    if (++tick == 1U << TAGE_AGE_PERIOD) {
+        tick = 0;
+        age();
+    }
+    retire_hist.push(taken);
+}
+
+// ------ PERCEPTRON -------//
+
+/*
+ * Weight i of a row goes with bit i of its segment, +1 for taken and -1
+ * for not taken. Weights saturate at +-127 so that negating one never
+ * overflows.
+ */
+static int perc_dot_scalar(const int8_t *w, uint32_t seg) {
+    int sum = 0;
+    for (int i = 0; i < PERC_SEG_BITS; i++)
+        sum += (seg >> i & 1) ? w[i] : -w[i];
+    return sum;
+}
+
+static void perc_train_scalar(int8_t *w, uint32_t seg, bool taken) {
+    for (int i = 0; i < PERC_SEG_BITS; i++) {
+        int v = w[i] + (((seg >> i & 1) == taken) ? 1 : -1);
+        if (v > 127) v = 127;
+        if (v < -127) v = -127;
+        w[i] = (int8_t) v;
+    }
+}
+
+// 16 outcome bits as 16 bytes of +1/-1
+__attribute__((target("ssse3")))
+static inline __m128i perc_signs_ssse3(uint32_t bits) {
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1);
+    const __m128i bit = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                      1, 2, 4, 8, 16, 32, 64, -128);
+    __m128i v = _mm_shuffle_epi8(_mm_cvtsi32_si128((int) bits), spread);
+    __m128i clear = _mm_cmpeq_epi8(_mm_and_si128(v, bit), _mm_setzero_si128());
+    return _mm_or_si128(clear, _mm_set1_epi8(1));
+}
+
+__attribute__((target("ssse3")))
+static int perc_dot_ssse3(const int8_t *w, uint32_t seg) {
+    const __m128i ones8 = _mm_set1_epi8(1);
+    const __m128i ones16 = _mm_set1_epi16(1);
+    __m128i lo = _mm_sign_epi8(_mm_loadu_si128((const __m128i *) w), perc_signs_ssse3(seg));
+    __m128i hi = _mm_sign_epi8(_mm_loadu_si128((const __m128i *) (w + 16)),
+                               perc_signs_ssse3(seg >> 16));
+    // Bytes to pairwise 16-bit sums, then to 32-bit sums
+    __m128i sum = _mm_add_epi16(_mm_maddubs_epi16(ones8, lo), _mm_maddubs_epi16(ones8, hi));
+    sum = _mm_madd_epi16(sum, ones16);
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("ssse3")))
+static inline __m128i perc_step_ssse3(__m128i w, __m128i x, __m128i dir) {
+    const __m128i floor = _mm_set1_epi8(-128);
+    w = _mm_adds_epi8(w, _mm_sign_epi8(x, dir));
+    return _mm_sub_epi8(w, _mm_cmpeq_epi8(w, floor)); // -128 -> -127
+}
+
+__attribute__((target("ssse3")))
+static void perc_train_ssse3(int8_t *w, uint32_t seg, bool taken) {
+    __m128i dir = _mm_set1_epi8(taken ? 1 : -1);
+    __m128i lo = _mm_loadu_si128((const __m128i *) w);
+    __m128i hi = _mm_loadu_si128((const __m128i *) (w + 16));
+    _mm_storeu_si128((__m128i *) w, perc_step_ssse3(lo, perc_signs_ssse3(seg), dir));
+    _mm_storeu_si128((__m128i *) (w + 16), perc_step_ssse3(hi, perc_signs_ssse3(seg >> 16), dir));
+}
+
+// 32 outcome bits as 32 bytes of +1/-1
+__attribute__((target("avx2")))
+static inline __m256i perc_signs_avx2(uint32_t bits) {
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bit = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                         1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+    __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32((int) bits), spread);
+    __m256i clear = _mm256_cmpeq_epi8(_mm256_and_si256(v, bit), _mm256_setzero_si256());
+    return _mm256_or_si256(clear, _mm256_set1_epi8(1));
+}
+
+__attribute__((target("avx2")))
+static int perc_dot_avx2(const int8_t *w, uint32_t seg) {
+    __m256i p = _mm256_sign_epi8(_mm256_loadu_si256((const __m256i *) w), perc_signs_avx2(seg));
+    __m256i sum = _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_set1_epi8(1), p),
+                                    _mm256_set1_epi16(1));
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(1, 0, 3, 2)));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s);
+}
+
+__attribute__((target("avx2")))
+static void perc_train_avx2(int8_t *w, uint32_t seg, bool taken) {
+    __m256i v = _mm256_loadu_si256((const __m256i *) w);
+    v = _mm256_adds_epi8(v, _mm256_sign_epi8(perc_signs_avx2(seg), _mm256_set1_epi8(taken ? 1 : -1)));
+    v = _mm256_sub_epi8(v, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(-128)));
+    _mm256_storeu_si256((__m256i *) w, v);
+}
+
+perceptron_predictor::perceptron_predictor(const predictor_config &cfg)
+    : segments(cfg.perc_segments), log_rows(cfg.perc_log_rows) {
+    theta = cfg.perc_theta ? (int) cfg.perc_theta
+                           : (int) (1.93 * segments * PERC_SEG_BITS + 14);
+
+    uint32_t simd = cfg.perc_simd;
+    if (simd == PERC_SIMD_AUTO)
+        simd = __builtin_cpu_supports("avx2") ? PERC_SIMD_AVX2
+             : __builtin_cpu_supports("ssse3") ? PERC_SIMD_SSE : PERC_SIMD_SCALAR;
+    if (simd == PERC_SIMD_AVX2 && !__builtin_cpu_supports("avx2"))
+        simd = PERC_SIMD_SSE;
+    if (simd == PERC_SIMD_SSE && !__builtin_cpu_supports("ssse3"))
+        simd = PERC_SIMD_SCALAR;
+    if (simd == PERC_SIMD_AVX2) {
+        dot = perc_dot_avx2;
+        train = perc_train_avx2;
+    } else if (simd == PERC_SIMD_SSE) {
+        dot = perc_dot_ssse3;
+        train = perc_train_ssse3;
+    } else {
+        dot = perc_dot_scalar;
+        train = perc_train_scalar;
+    }
+
+    for (uint32_t k = 0; k < segments; k++)
+        weights[k].assign((size_t) PERC_SEG_BITS << log_rows, 0);
+    bias.assign(1U << log_rows, 0);
+    memset(fetch_hist, 0, sizeof(fetch_hist));
+    memset(retire_hist, 0, sizeof(retire_hist));
+}
+
+uint32_t perceptron_predictor::row(uint32_t pc, const uint32_t *hist, uint32_t k) const {
+    uint32_t x = pc ^ (k * 0x9e3779b9U);
+    if (k > 0) {
+        // Fold the previous segment in
+        uint32_t h = hist[k - 1];
+        for (uint32_t shift = 0; shift < PERC_SEG_BITS; shift += log_rows)
+            x ^= h >> shift;
+    }
+    x ^= x >> log_rows;
+    return x & ((1U << log_rows) - 1);
+}
+
+int perceptron_predictor::output(uint32_t pc, const uint32_t *hist) const {
+    int sum = bias[pc & ((1U << log_rows) - 1)];
+    for (uint32_t k = 0; k < segments; k++)
+        sum += dot(&weights[k][(size_t) row(pc, hist, k) * PERC_SEG_BITS], hist[k]);
+    return sum;
+}
+
+void perceptron_predictor::push(uint32_t *hist, bool taken) {
+    for (uint32_t k = segments - 1; k > 0; k--)
+        hist[k] = (hist[k] << 1) | (hist[k - 1] >> (PERC_SEG_BITS - 1));
+    hist[0] = (hist[0] << 1) | taken;
+}
+
+void perceptron_predictor::update(uint32_t pc, uint32_t, bool taken) {
+    int sum = output(pc, retire_hist);
+    if ((sum >= 0) != taken || abs(sum) <= theta) {
+        int8_t &b = bias[pc & ((1U << log_rows) - 1)];
+        if (taken && b < 127) b++;
+        if (!taken && b > -127) b--;
+        // Rows are picked before training changes anything
+        uint32_t rows[PERC_MAX_SEGMENTS];
+        for (uint32_t k = 0; k < segments; k++)
+            rows[k] = row(pc, retire_hist, k);
+        for (uint32_t k = 0; k < segments; k++)
+            train(&weights[k][(size_t) rows[k] * PERC_SEG_BITS], retire_hist[k], taken);
+    }
+    push(retire_hist, taken);
+}
+
+// ------ TOURNAMENT -------//
+
+tournament_predictor::tournament_predictor(const predictor_config &cfg)
+    : bits(cfg.tour_chooser_bits), branches(0), disagree(0) {
+    component[0] = make_predictor(TWO_BIT_PREDICTOR_, cfg);
+    component[1] = make_predictor(GSHARE_PREDICTOR_, cfg);
+    chooser.init(1U << bits, COUNTER_INIT); // start out trusting the 2-bit
+    for (int c = 0; c < 2; c++)
+        chosen[c] = chosen_correct[c] = correct[c] = 0;
+}
+
+tournament_predictor::~tournament_predictor() {
+    delete component[0];
+    delete component[1];
+}
+
+bool tournament_predictor::predict(uint32_t pc, uint32_t hist) {
+    bool p0 = component[0]->predict(pc, hist);
+    bool p1 = component[1]->predict(pc, hist);
+    return chooser.predict(pc) ? p1 : p0;
+}
+
+void tournament_predictor::fetched(uint32_t pc, bool taken) {
+    component[0]->fetched(pc, taken);
+    component[1]->fetched(pc, taken);
+}
+
+void tournament_predictor::update(uint32_t pc, uint32_t hist, bool taken) {
+    bool p[2] = { component[0]->predict(pc, hist), component[1]->predict(pc, hist) };
+    int c = chooser.predict(pc);
+
+    branches++;
+    chosen[c]++;
+    chosen_correct[c] += p[c] == taken;
+    correct[0] += p[0] == taken;
+    correct[1] += p[1] == taken;
+
+    // Only a disagreement says which one to trust
+    if (p[0] != p[1]) {
+        disagree++;
+        chooser.update(pc, p[1] == taken);
+    }
+    component[0]->update(pc, hist, taken);
+    component[1]->update(pc, hist, taken);
+}
+
+static double percent(uint64_t part, uint64_t whole) {
+    return whole ? 100.0 * part / whole : 0.0;
+}
+
+void tournament_predictor::report() const {
+    printf("Tournament: %" PRIu64 " branches, components disagree on %.2f%%\n",
+           branches, percent(disagree, branches));
+    for (int c = 0; c < 2; c++)
+        printf("  %-26s chosen %6.2f%%  accuracy when chosen %6.2f%%  overall %6.2f%%\n",
+               component[c]->name(), percent(chosen[c], branches),
+               percent(chosen_correct[c], chosen[c]), percent(correct[c], branches));
+}
+
 // This function runs ONCE when the simulation starts. Globals
 // state should be initialized here, if there is any that is
-// shared between predictors. (There probably will not
-// be any modifications here)
+// shared between predictors.
 void PredictorInit() {
     runs = 0;
-    printf("G-Select table size\t %x\n", G_SHARE_TABLE_SIZE);
-    printf("History bitmask\t\t %d\n", G_SHARE_HIS_BITS);
+    num_slots = 0;
+    default_config(config);
+    const char *path = getenv("BP_CONFIG");
+    if (path && *path)
+        read_config(path, config);
+
+    printf("Runs\t\t\t");
+    for (uint32_t r = 0; r < config.num_runs; r++)
+        printf(" %s", predictor_names[config.runs[r]]);
+    printf(config.single_pass ? "\t(single pass)\n" : "\n");
+    printf("2-bit table size\t %u\n", table_entries(config.b2_entries, config.b2_addr_bits));
+    printf("G-Select table size\t %u\t(%u address, %u history bits)\n",
+           table_entries(config.gsel_entries, config.gsel_addr_bits + config.gsel_his_bits),
+           config.gsel_addr_bits, config.gsel_his_bits);
+    printf("G-Share table size\t %u\t(%u address, %u history bits)\n",
+           table_entries(config.gshare_entries, config.gshare_addr_bits > config.gshare_his_bits
+                                                 ? config.gshare_addr_bits : config.gshare_his_bits),
+           config.gshare_addr_bits, config.gshare_his_bits);
+    printf("TAGE tables\t\t %u x %u\t(%u-bit tags, history %u..%u, base %u)\n",
+           config.tage_tables, 1U << config.tage_log_entries, config.tage_tag_bits,
+           config.tage_min_hist, config.tage_max_hist, 1U << config.tage_base_bits);
+    printf("Perceptron tables\t %u x %u x %d\t(history %u)\n",
+           config.perc_segments, 1U << config.perc_log_rows, PERC_SEG_BITS,
+           config.perc_segments * PERC_SEG_BITS);
+    printf("Tournament chooser\t %u\n", 1U << config.tour_chooser_bits);
     printf("\n");
 }
 
 // This function is called before EVERY run
 // It is used to reset predictors and change configurations
 void PredictorReset() {
-    
     // Predictor Specific Setup
-    if (runs == TWO_BIT_PREDICTOR_)
-        printf("Predictor: 2-bit saturating-counter\n");
-    else if (runs == GSELECT_PREDICTOR_)
-        printf("Predictor: gseletct\n");
-    else if (runs == GSHARE_PREDICTOR_)
-        printf("Predictor: gshare\n");
-
-    // Branch History Register Resets
-    brh_fetch = 0;
-    brh_retire = 0;
+    for (uint32_t s = 0; s < num_slots; s++)
+        delete slots[s].pred;
+    num_slots = config.single_pass ? config.num_runs : 1;
+    for (uint32_t s = 0; s < num_slots; s++) {
+        predictor_slot &slot = slots[s];
+        slot.pred = make_predictor(config.runs[config.single_pass ? s : runs], config);
+        printf("Predictor: %s%s\n", slot.pred->name(),
+               num_slots > 1 && s == 0 ? " (drives the pipeline)" : "");
+
+        // Branch History Register Resets
+        slot.brh_fetch = 0;
+        slot.brh_retire = 0;
+        slot.mispredicts = 0;
+    }
+    retired_insts = 0;
 }
 
-// ------ 2-BIT SATURATION STUFF -------//
-uint8_t state_2b[B2_TABLE_SIZE] = {1};
-
-// -------- GSHARE STUFF ----------//
-
-// GSHARE Prediction Table
-char state_gshare[G_SHARE_TABLE_SIZE] = {1}; // Begin at state 1
-
 void PredictorRunACycle() {
     // Stores info about what uops are being processed at each pipeline stage
     const cbp3_cycle_activity_t *cycle_info = get_cycle_info();
@@ -88,74 +703,25 @@ void PredictorRunACycle() {
     fetch stage of the processor. During the fetch stage the branch
     predictor makes a prediction (taken or not-taken), but doesn't
     actually know if the branch was taken or not, so it can't
-    update itself with new information. In the loop below, add
-    the logic for predicting whether or not the branch should be
-    taken according to the current state of the predictor. 
+    update itself with new information.
      */
     for (int i = 0; i < cycle_info->num_fetch; i++) {
         uint32_t fe_ptr = cycle_info->fetch_q[i];
         const cbp3_uop_dynamic_t *uop = &fetch_entry(fe_ptr)->uop;
 
         if (!(uop->type & IS_BR_CONDITIONAL)) continue;
-        if (runs == TWO_BIT_PREDICTOR_) {
-            // -- PLACE YOUR TWO BIT SATURATING COUNTER PREDICTION CODE BELOW
-            // (only put predictions in this section, updating states happens
-            // below)
-	    // Set `gpred` based off whether or not a branch should be taken
-	    bool gpred = true; 
-	    int index = uop->pc & ((int) B2_TABLE_SIZE);
-	    if (state_2b[index] < 2)
-	    {
-		gpred = false;
-	    }
-	    else
-	    {
-		gpred = true;
-	    }
-
-            assert(report_pred(fe_ptr, false, gpred));
-
-        } else if (runs == GSELECT_PREDICTOR_) {
-            // -- PLACE YOUR GSELECT PREDICTION CODE BELOW
-            // (only put predictions in this section, updating states happens
-            // below)
-
-            // Set `gpred` based off whether or not a branch should be taken
-            bool gpred = true;
-
-            
-	    assert(report_pred(fe_ptr, false, gpred));
-
-        } else if (runs == GSHARE_PREDICTOR_) {
-            // -- PLACE YOUR GSHARE PREDICTION CODE BELOW
-            // (only put predictions in this section, updating states happens
-            // below)
-
-            // Set `gpred` based off whether or not a branch should be taken
-            bool gpred = true; 
-
-	    // Collect lower byte of branch address
-	    int addr = uop->pc & ((1 << G_SHARE_ADDR_BITS) - 1);
-	    int hist = brh_fetch & ((1 << G_SHARE_HIS_BITS) - 1);
-	    // XOR with N bits of history
-	    int index_gselect = addr ^ hist; 
-	    // Read from table at calculated index and set prediction 
-	    if (state_gshare[index_gselect] < 2) 
-		   gpred = false;
-	    else
-		   gpred = true; 
-	   
-	    
-            assert(report_pred(fe_ptr, false, gpred));
 
-        }
-
-        // -- UPDATE THE `brh_fetch` branch history register here. See "hints" in
-        // the assignment description for more information on this.
-
-	// Update brh_fetch GSelect
-	brh_fetch = (brh_fetch << 1) | uop->br_taken;
+        for (uint32_t s = 0; s < num_slots; s++) {
+            predictor_slot &slot = slots[s];
+            bool gpred = slot.pred->predict(uop->pc, slot.brh_fetch);
+            if (s == 0)
+                assert(report_pred(fe_ptr, false, gpred));
+            slot.mispredicts += gpred != uop->br_taken;
+            slot.pred->fetched(uop->pc, uop->br_taken);
 
+            // Update brh_fetch
+            slot.brh_fetch = (slot.brh_fetch << 1) | uop->br_taken;
+        }
     }
 
     /*
@@ -169,65 +735,35 @@ void PredictorRunACycle() {
         uint32_t rob_ptr = cycle_info->retire_q[i];
         const cbp3_uop_dynamic_t *uop = &rob_entry(rob_ptr)->uop;
 
+        if (uop->type & IS_EOM) retired_insts++;
         if(!(uop->type & IS_BR_CONDITIONAL)) continue;
 
-        if (runs == TWO_BIT_PREDICTOR_) {
-            // -- UPDATE THE STATE OF THE TWO BIT SATURATING COUNTER HERE
-	    int index;
-            index = uop->pc & 0x0000ffff;
-	    if (uop->br_taken == 0)
-	    {
-		if (state_2b[index] != 0)
-		{
-		    state_2b[index]--;
-		}
-	    }
-	    else
-	    {
-		if (state_2b[index] != 3)
-		{
-		    state_2b[index]++;
-		}
-	    }
-        } else if (runs == GSELECT_PREDICTOR_) {
-            // -- UPDATE THE STATE OF THE GSELECT HERE
-	    
-	     	    
-	    
-        } else if (runs == GSHARE_PREDICTOR_) {
-            // -- UPDATE THE STATE OF THE GSHARE HERE
-	    
-	    // Collect lower byte of branch address
-	    int addr = uop->pc & ((1 << G_SHARE_ADDR_BITS) - 1);
-	    int hist = brh_retire & ((1 << G_SHARE_HIS_BITS) - 1);
-	    // XOR with N bits of history
-	    int index_gshare = addr ^ hist; 
-	    // Collect branch result
-	    bool res_gshare = uop->br_taken;
-	    // Update prediction table
-	    if (res_gshare) {
-		if (state_gshare[index_gshare] < 3) state_gshare[index_gshare]++;
-	    }
-	    else {
-	    	if (state_gshare[index_gshare] > 0) state_gshare[index_gshare]--;
-	    }
+        for (uint32_t s = 0; s < num_slots; s++) {
+            predictor_slot &slot = slots[s];
+            slot.pred->update(uop->pc, slot.brh_retire, uop->br_taken);
 
+            // Update brh_retire
+            slot.brh_retire = (slot.brh_retire << 1) | uop->br_taken;
         }
-
-        // -- UPDATE THE `brh_retire` branch history register here. See "hints" in
-        // the assignment description for more information on this.
-	
-	// Update brh_retire
-	brh_retire = (brh_retire << 1) | uop->br_taken;
-
     }
 }
 
 void PredictorRunEnd() {
+    for (uint32_t s = 0; s < num_slots; s++) {
+        const predictor_slot &slot = slots[s];
+        printf("%-26s mispredicts %8" PRIu64 "  MPKI %8.4f\n", slot.pred->name(),
+               slot.mispredicts, retired_insts ? 1000.0 * slot.mispredicts / retired_insts : 0.0);
+        slot.pred->report();
+    }
+    printf("\n");
     runs ++;
-    if (runs < 3) // set rewind_marked to indicate that we want more runs
+    // set rewind_marked to indicate that we want more runs
+    if (!config.single_pass && runs < config.num_runs)
         rewind_marked = true;
 }
 
 void PredictorExit() {
+    for (uint32_t s = 0; s < num_slots; s++)
+        delete slots[s].pred;
+    num_slots = 0;
 }
@@ -1,10 +1,19 @@
 #ifndef __PREDICTOR_H__
-#define __PREDICTO_H__
+#define __PREDICTOR_H__
+
+#include <stdint.h>
+#include <vector>
+
+/*
+ * Default geometry. Every value can be changed at start-up, without
+ * recompiling cbp3, from the file named by the BP_CONFIG environment
+ * variable (see predictor_config below).
+ */
+
 /*
  * 2B Saturation Stuff
  */
 #define B2_ADDR_BITS 16 // Number of bits to use from PC for index
-#define B2_TABLE_SIZE ((1 << B2_ADDR_BITS) - 1) // Variable state used for TWO_BIT_PREDICTOR
 
 /*
  * G-Share Stuff
@@ -13,12 +22,6 @@
 #define G_SHARE_ADDR_BITS 16 // (M) Number of bits to use from PC for index
 #define G_SHARE_HIS_BITS 8 // (N) Number of bits to use from history for index
 
-#if G_SHARE_ADDR_BITS > G_SHARE_HIS_BITS
-   #define G_SHARE_TABLE_SIZE ((1 << G_SHARE_ADDR_BITS) - 1)
-#else
-   #define G_SHARE_TABLE_SIZE ((1 << G_SHARE_HIS_BITS) - 1)
-#endif
-
 /*
  * G-Select Stuff
  */
@@ -26,4 +29,369 @@
 #define G_SEL_ADDR_BITS 8 // (M) Number of bits to use from PC for index
 #define G_SEL_HIS_BITS 8 // (N) Number of bits to use from history for index
 
+/*
+ * TAGE Stuff
+ */
+#define TAGE_BASE_BITS 14   // Bimodal base table of 2^bits counters
+#define TAGE_TABLES 7       // Number of tagged tables
+#define TAGE_LOG_ENTRIES 10 // Each tagged table has 2^bits entries
+#define TAGE_TAG_BITS 10    // Partial tag width
+#define TAGE_MIN_HIST 4     // History length of the first tagged table
+#define TAGE_MAX_HIST 320   // History length of the last tagged table
+#define TAGE_MAX_TABLES 16
+#define TAGE_AGE_PERIOD 18  // Useful bits are halved every 2^period updates
+
+/*
+ * Perceptron Stuff
+ */
+#define PERC_SEG_BITS 32      // History bits per segment, one weight row each
+#define PERC_SEGMENTS 2       // Number of history segments
+#define PERC_MAX_SEGMENTS 8
+#define PERC_LOG_ROWS 10      // Each segment table has 2^bits rows
+#define PERC_SIMD_SCALAR 0    // Dot product / training kernels
+#define PERC_SIMD_SSE 1
+#define PERC_SIMD_AVX2 2
+#define PERC_SIMD_AUTO 3      // Best one the CPU supports
+
+/*
+ * Tournament Stuff
+ */
+#define TOUR_CHOOSER_BITS 12 // PC indexed chooser of 2^bits counters
+
+/*
+ * Predictor kinds, also the default run order
+ */
+#define TWO_BIT_PREDICTOR_ 0U
+#define GSELECT_PREDICTOR_ 1U
+#define GSHARE_PREDICTOR_  2U
+#define TAGE_PREDICTOR_    3U
+#define PERCEPTRON_PREDICTOR_ 4U
+#define TOURNAMENT_PREDICTOR_ 5U
+#define NUM_PREDICTORS_    6U
+
+#define MAX_RUNS 16
+
+/*
+ * Run-time configuration, read from BP_CONFIG as "key = value" lines
+ * ('#' starts a comment):
+ *
+ *   predictors        run order, e.g. "gshare 2bit" (default: all of them)
+ *   single_pass       1 to evaluate every predictor in one run instead of
+ *                     one run each; the first one drives the pipeline
+ *   b2_addr_bits      bimodal table of 2^bits counters
+ *   gshare_addr_bits  gshare table of 2^max(addr, his) counters
+ *   gshare_his_bits
+ *   gsel_addr_bits    gselect table of 2^(addr + his) counters
+ *   gsel_his_bits
+ *   tage_base_bits    TAGE bimodal base table of 2^bits counters
+ *   tage_tables       number of tagged tables, 1..TAGE_MAX_TABLES
+ *   tage_log_entries  each tagged table has 2^bits entries
+ *   tage_tag_bits     partial tag width, 4..16
+ *   tage_min_hist     history lengths grow geometrically from min to max
+ *   tage_max_hist
+ *   perc_segments     perceptron history of segments x PERC_SEG_BITS outcomes
+ *   perc_log_rows     each segment table has 2^bits weight rows
+ *   perc_theta        training threshold, 0 for 1.93 * history + 14
+ *   perc_simd         0 scalar, 1 SSE, 2 AVX2, 3 best available
+ *   tour_chooser_bits tournament chooser of 2^bits counters; its components
+ *                     are the 2bit and gshare predictors configured above
+ *
+ * b2_entries, gshare_entries and gsel_entries override a table size with
+ * any number of counters; tables that are not a power of two are indexed
+ * with a modulo instead of a mask.
+ */
+struct predictor_config {
+    uint32_t runs[MAX_RUNS];
+    uint32_t num_runs;
+    uint32_t single_pass;
+
+    uint32_t b2_addr_bits;
+    uint32_t b2_entries;
+    uint32_t gshare_addr_bits;
+    uint32_t gshare_his_bits;
+    uint32_t gshare_entries;
+    uint32_t gsel_addr_bits;
+    uint32_t gsel_his_bits;
+    uint32_t gsel_entries;
+    uint32_t tage_base_bits;
+    uint32_t tage_tables;
+    uint32_t tage_log_entries;
+    uint32_t tage_tag_bits;
+    uint32_t tage_min_hist;
+    uint32_t tage_max_hist;
+    uint32_t perc_segments;
+    uint32_t perc_log_rows;
+    uint32_t perc_theta;
+    uint32_t perc_simd;
+    uint32_t tour_chooser_bits;
+};
+
+/*
+ * Table of 2-bit saturating counters. Pow2 tables reduce an index with a
+ * mask, the others with a modulo; the choice is a template parameter so
+ * the common power-of-two case has no division in the cycle loop.
+ */
+template <bool Pow2>
+class counter_table {
+public:
+    void init(uint32_t entries, uint8_t state) {
+        table.assign(entries, state);
+        size = entries;
+        mask = entries - 1;
+    }
+    uint32_t entries() const { return size; }
+    uint32_t index(uint32_t x) const { return Pow2 ? (x & mask) : (x % size); }
+    bool predict(uint32_t x) const { return table[index(x)] >= 2; }
+    void update(uint32_t x, bool taken) {
+        uint8_t &c = table[index(x)];
+        if (taken) {
+            if (c < 3) c++;
+        } else {
+            if (c > 0) c--;
+        }
+    }
+
+private:
+    std::vector<uint8_t> table;
+    uint32_t size;
+    uint32_t mask;
+};
+
+/*
+ * One branch predictor. predict() is called at fetch with the fetch
+ * history, update() at retire with the retire history, both with the
+ * newest outcome in bit 0. Predictors that keep a longer history of their
+ * own see each outcome at fetch through fetched(), and at retire through
+ * update(). report() prints any statistics at the end of a run.
+ */
+class predictor_component {
+public:
+    virtual ~predictor_component() {}
+    virtual const char *name() const = 0;
+    virtual bool predict(uint32_t pc, uint32_t hist) = 0;
+    virtual void fetched(uint32_t, bool) {}
+    virtual void update(uint32_t pc, uint32_t hist, bool taken) = 0;
+    virtual void report() const {}
+};
+
+static inline uint32_t low_bits(uint32_t x, uint32_t bits) {
+    return bits >= 32 ? x : x & ((1U << bits) - 1);
+}
+
+// Counters start weakly not-taken
+#define COUNTER_INIT 1
+
+template <bool Pow2>
+class bimodal_predictor : public predictor_component {
+public:
+    bimodal_predictor(const predictor_config &cfg) : bits(cfg.b2_addr_bits) {
+        table.init(cfg.b2_entries ? cfg.b2_entries : 1U << bits, COUNTER_INIT);
+    }
+    const char *name() const { return "2-bit saturating-counter"; }
+    bool predict(uint32_t pc, uint32_t) { return table.predict(low_bits(pc, bits)); }
+    void update(uint32_t pc, uint32_t, bool taken) { table.update(low_bits(pc, bits), taken); }
+
+private:
+    uint32_t bits;
+    counter_table<Pow2> table;
+};
+
+template <bool Pow2>
+class gshare_predictor : public predictor_component {
+public:
+    gshare_predictor(const predictor_config &cfg)
+        : addr_bits(cfg.gshare_addr_bits), his_bits(cfg.gshare_his_bits) {
+        uint32_t bits = addr_bits > his_bits ? addr_bits : his_bits;
+        table.init(cfg.gshare_entries ? cfg.gshare_entries : 1U << bits, COUNTER_INIT);
+    }
+    const char *name() const { return "gshare"; }
+    bool predict(uint32_t pc, uint32_t hist) { return table.predict(hash(pc, hist)); }
+    void update(uint32_t pc, uint32_t hist, bool taken) { table.update(hash(pc, hist), taken); }
+
+private:
+    // N bits of history XORed onto M bits of the address
+    uint32_t hash(uint32_t pc, uint32_t hist) const {
+        return low_bits(pc, addr_bits) ^ low_bits(hist, his_bits);
+    }
+    uint32_t addr_bits, his_bits;
+    counter_table<Pow2> table;
+};
+
+template <bool Pow2>
+class gselect_predictor : public predictor_component {
+public:
+    gselect_predictor(const predictor_config &cfg)
+        : addr_bits(cfg.gsel_addr_bits), his_bits(cfg.gsel_his_bits) {
+        table.init(cfg.gsel_entries ? cfg.gsel_entries : 1U << (addr_bits + his_bits), COUNTER_INIT);
+    }
+    const char *name() const { return "gselect"; }
+    bool predict(uint32_t pc, uint32_t hist) { return table.predict(hash(pc, hist)); }
+    void update(uint32_t pc, uint32_t hist, bool taken) { table.update(hash(pc, hist), taken); }
+
+private:
+    // M bits of the address concatenated with N bits of history
+    uint32_t hash(uint32_t pc, uint32_t hist) const {
+        return (low_bits(pc, addr_bits) << his_bits) | low_bits(hist, his_bits);
+    }
+    uint32_t addr_bits, his_bits;
+    counter_table<Pow2> table;
+};
+
+/*
+ * Global history folded down to a few bits by XOR, kept up to date one
+ * outcome at a time so a table index never has to walk the whole history
+ */
+struct folded_history {
+    uint32_t comp;
+    uint32_t clength;  // folded width
+    uint32_t olength;  // history length
+    uint32_t outpoint; // where the oldest bit leaves the fold
+
+    void init(uint32_t original, uint32_t compressed) {
+        comp = 0;
+        olength = original;
+        clength = compressed;
+        outpoint = olength % clength;
+    }
+    // newest is the outcome just pushed, oldest the one leaving the window
+    void update(uint32_t newest, uint32_t oldest) {
+        comp = (comp << 1) ^ newest;
+        comp ^= oldest << outpoint;
+        comp ^= comp >> clength;
+        comp &= (1U << clength) - 1;
+    }
+};
+
+/*
+ * A TAGE history: the outcome bits, newest first, and every table's folded
+ * index and tag. The predictor keeps one at fetch and one at retire.
+ */
+struct tage_history {
+    std::vector<uint8_t> bits; // circular, bits[ptr] is the newest
+    uint32_t ptr;
+    uint32_t mask;
+    uint32_t tables;
+    const uint32_t *length;
+    folded_history index[TAGE_MAX_TABLES];
+    folded_history tag[2][TAGE_MAX_TABLES];
+
+    void init(uint32_t n, const uint32_t *hist_len, uint32_t log_entries, uint32_t tag_bits);
+    void push(bool taken);
+};
+
+/*
+ * TAGE: a bimodal base predictor and tagged tables of 3-bit counters
+ * indexed by the PC and geometrically longer global histories. The
+ * longest matching table provides the prediction; a mispredict allocates
+ * an entry in a longer table whose useful bits are clear.
+ */
+class tage_predictor : public predictor_component {
+public:
+    tage_predictor(const predictor_config &cfg);
+    const char *name() const { return "TAGE"; }
+    bool predict(uint32_t pc, uint32_t hist);
+    void fetched(uint32_t, bool taken) { fetch_hist.push(taken); }
+    void update(uint32_t pc, uint32_t hist, bool taken);
+
+private:
+    struct entry {
+        int8_t ctr;   // -4..3, taken when >= 0
+        uint8_t u;    // 0..3
+        uint16_t tag;
+    };
+    struct lookup {
+        uint32_t index[TAGE_MAX_TABLES];
+        uint16_t tag[TAGE_MAX_TABLES];
+        int provider, alt; // table numbers, -1 for the base predictor
+        bool provider_pred, alt_pred, pred;
+    };
+
+    void find(uint32_t pc, const tage_history &h, lookup &l) const;
+    void allocate(const lookup &l, bool taken);
+    void age();
+    uint32_t random();
+
+    uint32_t tables, log_entries, tag_bits;
+    uint32_t hist_len[TAGE_MAX_TABLES];
+    std::vector<entry> table[TAGE_MAX_TABLES];
+    counter_table<true> base;
+    tage_history fetch_hist, retire_hist;
+    int use_alt_on_na; // trust the alternate prediction for new entries when >= 0
+    uint32_t tick;
+    uint32_t seed;
+};
+
+/*
+ * Hashed perceptron. The global history is cut into segments of
+ * PERC_SEG_BITS outcomes, and each segment has its own table of rows of
+ * signed 8-bit weights, one weight per outcome. Segment 0 picks its row by
+ * the PC alone, segment k by the PC hashed with segment k-1. The
+ * prediction is the sign of a bias weight plus the dot product of every
+ * row with its segment taken as +1/-1; training nudges each weight toward
+ * agreement with the outcome when the prediction was wrong or the sum was
+ * within theta of zero. The dot products and training run 32 weights at a
+ * time with SSE or AVX2.
+ */
+class perceptron_predictor : public predictor_component {
+public:
+    perceptron_predictor(const predictor_config &cfg);
+    const char *name() const { return "perceptron"; }
+    bool predict(uint32_t pc, uint32_t) { return output(pc, fetch_hist) >= 0; }
+    void fetched(uint32_t, bool taken) { push(fetch_hist, taken); }
+    void update(uint32_t pc, uint32_t hist, bool taken);
+
+    // One row of PERC_SEG_BITS weights against one segment, bit i of seg
+    // being the outcome weight i stands for
+    typedef int (*dot_fn)(const int8_t *w, uint32_t seg);
+    typedef void (*train_fn)(int8_t *w, uint32_t seg, bool taken);
+
+private:
+    uint32_t row(uint32_t pc, const uint32_t *hist, uint32_t k) const;
+    int output(uint32_t pc, const uint32_t *hist) const;
+    void push(uint32_t *hist, bool taken);
+
+    uint32_t segments, log_rows;
+    int theta;
+    dot_fn dot;
+    train_fn train;
+    std::vector<int8_t> weights[PERC_MAX_SEGMENTS];
+    std::vector<int8_t> bias;
+    uint32_t fetch_hist[PERC_MAX_SEGMENTS]; // [0] holds the newest outcomes
+    uint32_t retire_hist[PERC_MAX_SEGMENTS];
+};
+
+/*
+ * Tournament: the 2-bit and gshare predictors side by side, with a PC
+ * indexed chooser of 2-bit counters (taken meaning gshare) that is only
+ * trained when the two disagree
+ */
+class tournament_predictor : public predictor_component {
+public:
+    tournament_predictor(const predictor_config &cfg);
+    ~tournament_predictor();
+    const char *name() const { return "tournament"; }
+    bool predict(uint32_t pc, uint32_t hist);
+    void fetched(uint32_t pc, bool taken);
+    void update(uint32_t pc, uint32_t hist, bool taken);
+    void report() const;
+
+private:
+    predictor_component *component[2]; // 2-bit, gshare
+    counter_table<true> chooser;
+    uint32_t bits;
+
+    // Counted at retire
+    uint64_t branches;
+    uint64_t disagree;
+    uint64_t chosen[2];
+    uint64_t chosen_correct[2];
+    uint64_t correct[2];
+};
+
+/*
+ * Build predictor kind for cfg, picking the power-of-two instantiation
+ * when its table size allows
+ */
+predictor_component *make_predictor(uint32_t kind, const predictor_config &cfg);
+
 #endif // __PREDICTOR_H__
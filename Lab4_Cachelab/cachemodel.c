@@ -0,0 +1,89 @@
+/*
+ * cachemodel.c - In-process LRU cache model used by the transpose tools
+ */
+#include <stdlib.h>
+#include "cachemodel.h"
+
+/*
+ * createCacheModel - Allocate an empty cache with 2^s sets of E lines
+ */
+cacheModel *createCacheModel(int s, int E, int b)
+{
+    cacheModel *c = malloc(sizeof(cacheModel));
+    size_t lines = ((size_t)1 << s) * (size_t)E;
+
+    c->s = s;
+    c->E = E;
+    c->b = b;
+    c->tags = malloc(lines * sizeof(unsigned long long));
+    c->times = malloc(lines * sizeof(unsigned long long));
+    resetCacheModel(c);
+    return c;
+}
+
+/*
+ * resetCacheModel - Invalidate every line and zero the counters
+ */
+void resetCacheModel(cacheModel *c)
+{
+    size_t lines = ((size_t)1 << c->s) * (size_t)c->E;
+
+    for (size_t i = 0; i < lines; i++) {
+        c->tags[i] = ~0ULL;
+        c->times[i] = 0;
+    }
+    c->clock = 0;
+    c->hits = 0;
+    c->misses = 0;
+    c->evictions = 0;
+}
+
+/*
+ * cacheModelAccess - Access one address. On a miss the first invalid line
+ *     of the set is filled, otherwise the least recently used one is
+ *     evicted, exactly as in csim.
+ */
+int cacheModelAccess(cacheModel *c, unsigned long long addr)
+{
+    unsigned long long block = addr >> c->b;
+    size_t set = (size_t)(block & ((1ULL << c->s) - 1));
+    unsigned long long tag = block >> c->s;
+    unsigned long long *tags = &c->tags[set * (size_t)c->E];
+    unsigned long long *times = &c->times[set * (size_t)c->E];
+    int victim = 0;
+
+    c->clock++;
+    for (int i = 0; i < c->E; i++) {
+        if (tags[i] == tag) {
+            times[i] = c->clock;
+            c->hits++;
+            return 1;
+        }
+    }
+
+    c->misses++;
+    for (int i = 0; i < c->E; i++) {
+        if (tags[i] == ~0ULL) {
+            victim = i;
+            break;
+        }
+        if (times[i] < times[victim])
+            victim = i;
+    }
+    if (tags[victim] != ~0ULL)
+        c->evictions++;
+
+    tags[victim] = tag;
+    times[victim] = c->clock;
+    return 0;
+}
+
+/*
+ * freeCacheModel - Release the cache
+ */
+void freeCacheModel(cacheModel *c)
+{
+    free(c->tags);
+    free(c->times);
+    free(c);
+}
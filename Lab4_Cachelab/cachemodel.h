@@ -0,0 +1,34 @@
+/*
+ * cachemodel.h - In-process LRU cache model used by the transpose tools
+ *
+ * Same replacement policy and hit/miss/eviction counting as csim, but
+ * driven by direct calls instead of a trace file, so tools can score
+ * address streams without writing or parsing traces.
+ */
+#ifndef CACHEMODEL_H
+#define CACHEMODEL_H
+
+typedef struct {
+    int s;
+    int E;
+    int b;
+    unsigned long long *tags;	/* [set][way], ~0 when invalid */
+    unsigned long long *times;	/* [set][way] last access time */
+    unsigned long long clock;
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+} cacheModel;
+
+/* Allocate an empty cache with 2^s sets of E lines of 2^b bytes */
+cacheModel *createCacheModel(int s, int E, int b);
+
+/* Invalidate every line and zero the counters */
+void resetCacheModel(cacheModel *c);
+
+/* Access one address, returns 1 on a hit and 0 on a miss */
+int cacheModelAccess(cacheModel *c, unsigned long long addr);
+
+void freeCacheModel(cacheModel *c);
+
+#endif /* CACHEMODEL_H */
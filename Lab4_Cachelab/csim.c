@@ -17,37 +17,132 @@
 int indexBits;
 int lineCount;
 int offsetBits;
-char traceFile[32];
 int hits = 0;
 int misses = 0;
 int evictions = 0;
 bool verboseOutput = false;
+int indexFunction = 0;
+
+// MULTI-TENANT VARIABLES
+// Every -t trace is one tenant. Tenants are interleaved into the same cache
+// and may be restricted to fill only the ways set in their way mask.
+#define MAX_TENANTS 8
+#define ALL_WAYS (~0ULL)
+#define WAY_ALLOWED(mask, way) ((way) >= 64 || (((mask) >> (way)) & 1ULL))
+#define INTERLEAVE_RR   0	// one record from each tenant in turn
+#define INTERLEAVE_TIME 1	// lowest timestamp first
+#define UCP_EPOCH 10000		// accesses between utility-based repartitions
+#define UCP_SAMPLE 32		// every UCP_SAMPLE'th set is monitored
+char traceFiles[MAX_TENANTS][256];
+int tenantCount = 0;
+int curTenant = 0;
+int interleaveMode = INTERLEAVE_RR;
+bool partitioned = false;
+bool utilityPartitioning = false;
+unsigned long long wayMask[MAX_TENANTS];
+int tenantHits[MAX_TENANTS];
+int tenantMisses[MAX_TENANTS];
+int tenantEvictions[MAX_TENANTS];
+int tenantCrossEvictions[MAX_TENANTS];	// lines of other tenants evicted
+
+// VICTIM CACHE AND MISS BUFFER VARIABLES
+// Both are off unless -V / -Q are given
+int victimLineCount = 0;	// lines in the fully associative victim cache
+int mshrCount = 0;		// miss status holding registers
+int missLatency = 20;		// accesses a miss stays outstanding
+int victimHits = 0;		// main cache misses found in the victim cache
+int swaps = 0;			// victim hits that pushed a line back out
+int mshrMerges = 0;		// hits on blocks still being filled
+int mshrStalls = 0;		// misses that found every MSHR busy
+
+// SECTOR VARIABLES
+// With -S each line is split into 2^(b-S) sectors of 2^S bytes that share
+// one tag but are fetched, validated and dirtied separately. Without -S a
+// line is a single sector and behaves as before.
+int sectorBits = -1;		// sector offset bits, -1 when not sectored
+bool curWrite = false;		// current access is a store
+int tagMisses = 0;		// misses that allocated a line
+int sectorMisses = 0;		// tag hits on a sector not yet fetched
+unsigned long long bytesFetched = 0;
+unsigned long long bytesWrittenBack = 0;
+
+// Set index functions selectable with -i
+#define INDEX_BITS  0	// plain bit selection
+#define INDEX_XOR   1	// XOR-fold every s-bit chunk of the block address
+#define INDEX_PRIME 2	// block address modulo the largest prime <= 2^s
+#define INDEX_SKEW  3	// skewed-associative, a different hash per way
+
+// Sets with more lines than this use a hashed tag index and an LRU list
+// instead of scanning every line on each access
+#define HASH_LOOKUP_THRESHOLD 8
+#define HASH_EMPTY -1
 
 typedef struct {
     bool valid;
-    int tag;
-    unsigned long long block;
+    unsigned long long tag;
+    unsigned long long block;	// block address (address without offset)
     unsigned long long accessTime;
+    int tenant;		// tenant that filled the line
+    unsigned long long sectorValid;	// bit i set if sector i is present
+    unsigned long long sectorDirty;	// bit i set if sector i was written
+    int lruPrev;	// next more recently used line (hashed sets only)
+    int lruNext;	// next less recently used line (hashed sets only)
 } line;
 
 typedef struct {
     line* lines;
+    int* hashTable;	// tag -> line index, open addressing (hashed sets only)
+    int hashMask;
+    int lruHead;	// most recently used line
+    int lruTail;	// least recently used line
+    int used;		// lines [0, used) are valid
 } set;
 
 typedef struct {
+    unsigned long long block;
+    unsigned long long readyTime;	// accessCounter value the fill completes
+} mshrEntry;
+
+typedef struct cache cache;
+struct cache {
     set* sets;
     int s;
     int E;
     int b;
     unsigned long long accessCounter;
-} cache;
+    bool hashed;
+    unsigned long long primeSets;	// number of sets used by INDEX_PRIME
+    void (*retrieve)(cache *c, unsigned long long addr);
+    int (*setIndex)(cache *c, unsigned long long addr);	// NULL for INDEX_SKEW
+    set victim;			// victim cache, victimLineCount lines
+    mshrEntry *mshrs;		// mshrCount entries
+    bool swapPending;		// current miss was served by the victim cache
+};
 
 typedef struct {
-    int tag;
+    unsigned long long tag;
     int idx;
     int offset;
 } addressParts;
 
+typedef struct {
+    FILE *fp;
+    bool done;
+    char operation;
+    unsigned long long addr;
+    int size;
+    unsigned long long time;
+} traceReader;
+
+// Utility monitor for utility-based partitioning: an LRU tag stack per tenant
+// per sampled set, counting hits at each stack position
+typedef struct {
+    unsigned long long *stacks;		// [tenant][sampled set][way]
+    unsigned long long *wayHits;	// [tenant][way]
+    int sampledSets;
+    unsigned long long accesses;
+} utilityMonitor;
+
 // DEBUG AND HELPER FUNCTIONS
 void printHelp();
 void printError();
@@ -57,20 +152,67 @@ void printArgs();
 cache* createCache(int s, int E, int b);
 void freeCache(cache* c);
 addressParts parseAddress(unsigned long long address, int s, int b);
+addressParts parseAddressXor(unsigned long long address, int s, int b);
+addressParts parseAddressPrime(unsigned long long address, unsigned long long sets, int b);
+int skewIndex(unsigned long long blockAddr, int way, int s);
+int setIndexBits(cache *c, unsigned long long addr);
+int setIndexXor(cache *c, unsigned long long addr);
+int setIndexPrime(cache *c, unsigned long long addr);
+int parseIndexFunction(const char *name);
 int getEvictLine(set *set_);
 void runTrace(cache *c);
 void retrieveCacheLine(cache *c, unsigned long long addr);
+void retrieveCacheLineXor(cache *c, unsigned long long addr);
+void retrieveCacheLinePrime(cache *c, unsigned long long addr);
+void retrieveCacheLineSkewed(cache *c, unsigned long long addr);
+void accessSet(cache *c, set *curSet, unsigned long long tag, unsigned long long addr);
+void retrieveCacheLineHashed(cache *c, set *curSet, unsigned long long tag, unsigned long long addr);
+unsigned int hashSlot(set *set_, unsigned long long tag);
+int hashFind(set *set_, unsigned long long tag);
+void hashInsert(set *set_, unsigned long long tag, int lineIdx);
+void hashRemove(set *set_, unsigned long long tag);
+void lruUnlink(set *set_, int lineIdx);
+void lruPushFront(set *set_, int lineIdx);
+
+// MULTI-TENANT FUNCTIONS
+bool readTraceRecord(traceReader *r);
+void simulateRecord(cache *c, traceReader *r, utilityMonitor *u);
+int nextTenant(traceReader *readers, int *rrNext);
+int parseWayMasks(char *arg);
+void umonCreate(utilityMonitor *u, int s, int E);
+void umonFree(utilityMonitor *u);
+void umonAccess(utilityMonitor *u, cache *c, unsigned long long addr);
+void umonRepartition(utilityMonitor *u);
+void printTenantSummary();
+
+// VICTIM CACHE AND MISS BUFFER FUNCTIONS
+void recordHit(cache *c, unsigned long long blockAddr);
+void recordMiss(cache *c, unsigned long long blockAddr);
+void recordEviction(cache *c, line *victimLine);
+bool victimProbe(cache *c, unsigned long long blockAddr);
+void victimInsert(cache *c, unsigned long long blockAddr);
+void mshrAllocate(cache *c, unsigned long long blockAddr);
+void printVictimSummary();
+
+// SECTOR FUNCTIONS
+unsigned long long sectorBit(unsigned long long addr);
+bool accessSector(cache *c, line *line_, unsigned long long addr);
+void fillSectors(line *line_, unsigned long long addr);
+void printSectorSummary();
 
 // MAIN FUNCTION CODE
 int main(int argc, char* argv[])
 {
     // Flag check
     // Required flags: s, E, b, t
-    // Optional flags: h
+    // Optional flags: h, v, i, m, u, r
     int opt;
     int sFlag = 0, eFlag = 0, bFlag = 0, tFlag = 0;
 
-    while((opt = getopt(argc, argv, "s:E:b:t:vh")) != -1) {
+    for (int i = 0; i < MAX_TENANTS; i++)
+	wayMask[i] = ALL_WAYS;
+
+    while((opt = getopt(argc, argv, "s:E:b:t:i:m:ur:V:Q:L:S:vh")) != -1) {
     	switch (opt) {
 	    case 'h':
 		printHelp();
@@ -96,11 +238,65 @@ int main(int argc, char* argv[])
 		break;
 
 	    case 't':
-		strncpy(traceFile, optarg, sizeof(traceFile)-1);
-		traceFile[sizeof(traceFile)-1] = '\0';
+		if (tenantCount == MAX_TENANTS) {
+		    printf("./csim: At most %d trace files\n", MAX_TENANTS);
+		    return 1;
+		}
+		strncpy(traceFiles[tenantCount], optarg, sizeof(traceFiles[0])-1);
+		traceFiles[tenantCount][sizeof(traceFiles[0])-1] = '\0';
+		tenantCount++;
 		tFlag = 1;
 		break;
 
+	    case 'm':
+		if (parseWayMasks(optarg) < 0) {
+		    printf("./csim: Malformed way mask list %s\n", optarg);
+		    return 1;
+		}
+		partitioned = true;
+		break;
+
+	    case 'u':
+		utilityPartitioning = true;
+		partitioned = true;
+		break;
+
+	    case 'r':
+		if (strcmp(optarg, "rr") == 0)
+		    interleaveMode = INTERLEAVE_RR;
+		else if (strcmp(optarg, "time") == 0)
+		    interleaveMode = INTERLEAVE_TIME;
+		else {
+		    printf("./csim: Unknown interleave mode %s\n", optarg);
+		    return 1;
+		}
+		break;
+
+	    case 'V':
+		victimLineCount = atoi(optarg);
+		break;
+
+	    case 'Q':
+		mshrCount = atoi(optarg);
+		break;
+
+	    case 'L':
+		missLatency = atoi(optarg);
+		break;
+
+	    case 'S':
+		sectorBits = atoi(optarg);
+		break;
+
+	    case 'i':
+		indexFunction = parseIndexFunction(optarg);
+		if (indexFunction < 0) {
+		    printf("./csim: Unknown index function %s\n", optarg);
+		    printHelp();
+		    return 1;
+		}
+		break;
+
 	    default:
 		printError();
 		printHelp();
@@ -114,6 +310,34 @@ int main(int argc, char* argv[])
 	return 1;
     }
 
+    if (sectorBits >= 0 && (sectorBits > offsetBits || offsetBits - sectorBits > 6)) {
+	printf("./csim: Sector bits must be between b-6 and b\n");
+	return 1;
+    }
+
+    if (partitioned && lineCount > 64) {
+	printf("./csim: Way partitioning supports at most 64 lines per set\n");
+	return 1;
+    }
+
+    for (int i = 0; i < tenantCount; i++) {
+	if (lineCount < 64 && !(wayMask[i] & ((1ULL << lineCount) - 1))) {
+	    printf("./csim: Way mask of tenant %d selects no lines\n", i);
+	    return 1;
+	}
+    }
+
+    if (utilityPartitioning && lineCount < tenantCount) {
+	printf("./csim: Utility-based partitioning needs at least one line per tenant\n");
+	return 1;
+    }
+
+    // The utility monitor samples whole sets, skewed ways have none
+    if (utilityPartitioning && indexFunction == INDEX_SKEW) {
+	printf("./csim: Utility-based partitioning does not support the skew index function\n");
+	return 1;
+    }
+
    
     // DEBUG: display input arguments
     printArgs();
@@ -129,56 +353,353 @@ int main(int argc, char* argv[])
     freeCache(myCache);
 
     // Get summary for grading
+    if (tenantCount > 1)
+	printTenantSummary();
+    if (victimLineCount > 0 || mshrCount > 0)
+	printVictimSummary();
+    if (sectorBits >= 0)
+	printSectorSummary();
     printSummary(hits, misses, evictions);
     return 0;
 }
 /*
  * Function:	runTrace
  * Input:	cache *<c> - dynamically allocated cache
- * 		char * <traceFile> - User input trace file
+ * 		char * <traceFiles> - User input trace files, one per tenant
  * Output:	void
  * Description:
- * Iterate through lines of the tracefile, searching for non-instruction load
+ * Iterate through lines of the tracefiles, searching for non-instruction load
  * operations. Any other operations (Load (L), Store (S), Modify (M)) will
  * generate an access to the cache. Modify instrucitons incur a second access,
  * as they are essentially a Load+Store pair.
+ *
+ * With several tracefiles, records are interleaved by nextTenant and the
+ * hit, miss and eviction counts of each access are also added to the
+ * tenant that issued it. With utility-based partitioning every access is
+ * fed to the utility monitor, which recomputes the way masks every
+ * UCP_EPOCH accesses. A single tracefile without it skips all of that and
+ * simulates its records in order.
  */
 void runTrace(cache *c) {
-    FILE *fp = fopen(traceFile, "r");
-    if (!fp) {
-    	printf("ERROR: cannot open trace file %s\n", traceFile);
-	exit(1);
+    traceReader readers[MAX_TENANTS];
+    utilityMonitor umon;
+    int rrNext = 0;
+
+    for (int t = 0; t < tenantCount; t++) {
+	readers[t].fp = fopen(traceFiles[t], "r");
+	if (!readers[t].fp) {
+	    printf("ERROR: cannot open trace file %s\n", traceFiles[t]);
+	    exit(1);
+	}
+	readers[t].time = 0;
+	readTraceRecord(&readers[t]);
     }
 
-    char operation;
-    unsigned long long addr;
-    int size;
+    if (tenantCount == 1 && !utilityPartitioning) {
+	for (traceReader *r = &readers[0]; !r->done; readTraceRecord(r))
+	    simulateRecord(c, r, NULL);
+	fclose(readers[0].fp);
+	return;
+    }
+
+    if (utilityPartitioning)
+	umonCreate(&umon, c->s, c->E);
+
+    while ((curTenant = nextTenant(readers, &rrNext)) >= 0) {
+	traceReader *r = &readers[curTenant];
+	int prevHits = hits, prevMisses = misses, prevEvictions = evictions;
+
+	if (verboseOutput && tenantCount > 1) printf("[%d] ", curTenant);
+	simulateRecord(c, r, utilityPartitioning ? &umon : NULL);
+
+	tenantHits[curTenant] += hits - prevHits;
+	tenantMisses[curTenant] += misses - prevMisses;
+	tenantEvictions[curTenant] += evictions - prevEvictions;
+
+	readTraceRecord(r);
+    }
+
+    if (utilityPartitioning)
+	umonFree(&umon);
 
-    while (fscanf(fp, " %c %llx,%d", &operation, &addr, &size) == 3) {
-    	if (operation == 'I')
+    for (int t = 0; t < tenantCount; t++)
+	fclose(readers[t].fp);
+}
+
+/*
+ * Function:	simulateRecord
+ * Input:	cache *<c>
+ * 		traceReader *<r> - reader holding the record to simulate
+ * 		utilityMonitor *<u> - monitor to feed, or NULL
+ * Output:	void
+ * Description:
+ * Access the cache for the current record of <r>, twice for a Modify.
+ * Each access is also fed to <u>, so the monitor sees the load and the
+ * store of a Modify just like the cache does.
+ */
+void simulateRecord(cache *c, traceReader *r, utilityMonitor *u) {
+    if (verboseOutput) printf("%c %llx,%d", r->operation, r->addr, r->size);
+    switch (r->operation) {
+	case 'L':
+	case 'S':
+	    curWrite = r->operation == 'S';
+	    if (u) umonAccess(u, c, r->addr);
+	    c->retrieve(c, r->addr);
+	    break;
+
+	case 'M':
+	    curWrite = false;
+	    if (u) umonAccess(u, c, r->addr);
+	    c->retrieve(c, r->addr);
+	    curWrite = true;
+	    if (u) umonAccess(u, c, r->addr);
+	    c->retrieve(c, r->addr);
+	    break;
+
+	default:
+	    printf("Read something weird: %c\n", r->operation);
+	    break;
+
+    }
+    if (verboseOutput) printf("\n");
+}
+
+/*
+ * Function:	readTraceRecord
+ * Input:	traceReader *<r>
+ * Output:	bool - false once the end of the trace is reached
+ * Description:
+ * Read the next non-instruction record of <r>'s tracefile. A record may end
+ * with an optional decimal timestamp (" L 10,4 1200"). Records without one
+ * are timestamped one past the previous record of the same trace.
+ */
+bool readTraceRecord(traceReader *r) {
+    char buf[256];
+
+    // parsed by hand, sscanf costs more than simulating the record
+    while (fgets(buf, sizeof(buf), r->fp)) {
+	char *p = buf, *end;
+	unsigned long long addr, time;
+	long size;
+
+	while (*p == ' ' || *p == '\t')
+	    p++;
+	if (*p == 'I' || *p == '\0' || *p == '\n')
 	    continue;
+	r->operation = *p++;
+	addr = strtoull(p, &end, 16);
+	if (end == p || *end != ',')
+	    continue;
+	p = end + 1;
+	size = strtol(p, &end, 10);
+	if (end == p)
+	    continue;
+	time = strtoull(end, &p, 10);
 
-	if (verboseOutput) printf("%c %llx,%d", operation, addr, size);
-	switch (operation) {
-	    case 'L':
-	    case 'S':
-		retrieveCacheLine(c, addr);
-		break;
+	r->addr = addr;
+	r->size = (int)size;
+	r->time = (p != end) ? time : r->time + 1;
+	r->done = false;
+	return true;
+    }
 
-	    case 'M':
-		retrieveCacheLine(c, addr);
-		retrieveCacheLine(c, addr);
-		break;
+    r->done = true;
+    return false;
+}
 
-	    default:
-		printf("Read something weird: %c\n", operation);
+/*
+ * Function:	nextTenant
+ * Input:	traceReader *<readers> - one reader per tenant
+ * 		int *<rrNext> - round-robin position, updated
+ * Output:	int - tenant whose record is simulated next, or -1 when all
+ * 		traces are done
+ * Description:
+ * INTERLEAVE_RR takes one record from each tenant in turn, skipping tenants
+ * whose trace has ended. INTERLEAVE_TIME takes the record with the lowest
+ * timestamp, breaking ties by tenant number.
+ */
+int nextTenant(traceReader *readers, int *rrNext) {
+    int best = -1;
+
+    if (interleaveMode == INTERLEAVE_TIME) {
+	for (int t = 0; t < tenantCount; t++) {
+	    if (!readers[t].done && (best < 0 || readers[t].time < readers[best].time))
+		best = t;
+	}
+	return best;
+    }
+
+    for (int i = 0; i < tenantCount; i++) {
+	int t = (*rrNext + i) % tenantCount;
+	if (!readers[t].done) {
+	    *rrNext = (t + 1) % tenantCount;
+	    return t;
+	}
+    }
+    return best;
+}
+
+/*
+ * Function:	parseWayMasks
+ * Input:	char *<arg> - comma separated hex way masks, one per tenant
+ * Output:	int - number of masks read, or -1 if <arg> is malformed
+ * Description:
+ * Fill wayMask from a CAT-style list such as "0xf0,0x0f". Bit i of a mask
+ * allows its tenant to fill way i. Hits are allowed in every way. Tenants
+ * without a mask keep ALL_WAYS.
+ */
+int parseWayMasks(char *arg) {
+    int count = 0;
+
+    for (char *tok = strtok(arg, ","); tok; tok = strtok(NULL, ",")) {
+	char *end;
+	unsigned long long mask = strtoull(tok, &end, 16);
+	if (*end != '\0' || mask == 0 || count == MAX_TENANTS)
+	    return -1;
+	wayMask[count++] = mask;
+    }
+
+    return count;
+}
+
+/*
+ * Function:	umonCreate
+ * Input:	utilityMonitor *<u>
+ * 		int <s>
+ * 		int <E>
+ * Output:	void
+ * Description:
+ * Allocate empty LRU tag stacks for every tenant on every UCP_SAMPLE'th set
+ * (at least one set) and zero the per-way hit counters.
+ */
+void umonCreate(utilityMonitor *u, int s, int E) {
+    int S = 1 << s;
+    u->sampledSets = (S + UCP_SAMPLE - 1) / UCP_SAMPLE;
+    u->accesses = 0;
+
+    long unsigned int stackEntries = (long unsigned int)(tenantCount * u->sampledSets * E);
+    u->stacks = malloc(stackEntries * sizeof(unsigned long long));
+    for (long unsigned int i = 0; i < stackEntries; i++)
+	u->stacks[i] = (unsigned long long) -1;
+
+    u->wayHits = calloc((long unsigned int)(tenantCount * E), sizeof(unsigned long long));
+}
+
+/*
+ * Function:	umonFree
+ * Input:	utilityMonitor *<u>
+ * Output:	void
+ */
+void umonFree(utilityMonitor *u) {
+    free(u->stacks);
+    free(u->wayHits);
+}
+
+/*
+ * Function:	umonAccess
+ * Input:	utilityMonitor *<u>
+ * 		cache *<c>
+ * 		unsigned long long <addr> - accessed address
+ * Output:	void
+ * Description:
+ * The set of <addr> comes from the cache's own index function, so the
+ * sampled sets are the ones the cache really uses. If the block of <addr>
+ * maps to a sampled set, look it up in the current tenant's
+ * LRU stack for that set as if the tenant had the whole set to itself. A hit
+ * at stack position p means the tenant would have hit with p+1 ways, so
+ * wayHits[p] is incremented. The block then moves to the top of the stack.
+ * Repartitions every UCP_EPOCH accesses.
+ */
+void umonAccess(utilityMonitor *u, cache *c, unsigned long long addr) {
+    unsigned long long blockAddr = addr >> offsetBits;
+    int setIdx = c->setIndex(c, addr);
+
+    if (setIdx % UCP_SAMPLE == 0) {
+	unsigned long long *stack = &u->stacks[(curTenant * u->sampledSets + setIdx / UCP_SAMPLE) * lineCount];
+	int pos = lineCount - 1;
+
+	for (int p = 0; p < lineCount; p++) {
+	    if (stack[p] == blockAddr) {
+		u->wayHits[curTenant * lineCount + p]++;
+		pos = p;
 		break;
+	    }
+	}
+
+	memmove(&stack[1], &stack[0], (long unsigned int)pos * sizeof(unsigned long long));
+	stack[0] = blockAddr;
+    }
+
+    if (++u->accesses % UCP_EPOCH == 0)
+	umonRepartition(u);
+}
+
+/*
+ * Function:	umonRepartition
+ * Input:	utilityMonitor *<u>
+ * Output:	void
+ * Description:
+ * Split the ways between tenants with the lookahead algorithm of utility-based
+ * cache partitioning: every tenant starts with one way, then the tenant with
+ * the highest marginal utility (extra hits per extra way, over any number of
+ * extra ways) gets those ways, until none are left. Each tenant then receives
+ * a contiguous way mask of its allocation and the counters are halved so old
+ * behaviour fades out.
+ */
+void umonRepartition(utilityMonitor *u) {
+    int alloc[MAX_TENANTS];
+    int balance = lineCount - tenantCount;
+
+    for (int t = 0; t < tenantCount; t++)
+	alloc[t] = 1;
 
+    while (balance > 0) {
+	int winner = 0, winnerWays = 1;
+	double bestUtility = -1.0;
+
+	for (int t = 0; t < tenantCount; t++) {
+	    unsigned long long gained = 0;
+	    for (int k = 1; k <= balance; k++) {
+		gained += u->wayHits[t * lineCount + alloc[t] + k - 1];
+		double utility = (double) gained / k;
+		if (utility > bestUtility) {
+		    bestUtility = utility;
+		    winner = t;
+		    winnerWays = k;
+		}
+	    }
 	}
-	if (verboseOutput) printf("\n");
+
+	alloc[winner] += winnerWays;
+	balance -= winnerWays;
+    }
+
+    int firstWay = 0;
+    for (int t = 0; t < tenantCount; t++) {
+	wayMask[t] = (alloc[t] == 64 ? ALL_WAYS : ((1ULL << alloc[t]) - 1)) << firstWay;
+	firstWay += alloc[t];
     }
 
-    fclose(fp);
+    for (int i = 0; i < tenantCount * lineCount; i++)
+	u->wayHits[i] >>= 1;
+}
+
+/*
+ * Function:	printTenantSummary
+ * Input:	void
+ * Output:	void
+ * Description:
+ * Print hits, misses, evictions, hit rate and the number of other tenants'
+ * lines evicted for every tenant, followed by its final way mask.
+ */
+void printTenantSummary() {
+    for (int t = 0; t < tenantCount; t++) {
+	int accesses = tenantHits[t] + tenantMisses[t];
+	double hitRate = accesses ? 100.0 * tenantHits[t] / accesses : 0.0;
+	printf("tenant %d (%s): hits:%d misses:%d evictions:%d cross-evictions:%d hit-rate:%.2f%% mask:%llx\n",
+	       t, traceFiles[t], tenantHits[t], tenantMisses[t], tenantEvictions[t],
+	       tenantCrossEvictions[t], hitRate, wayMask[t]);
+    }
 }
 
 
@@ -189,14 +710,58 @@ void runTrace(cache *c) {
  * Output:	void
  * Description:
  * Take in the cache <c> with address to access <addr> and parse <addr> into
- * an addressParts struct using parseAddress. Increment the LRU accessCounter.
- * With the parsed data, search the requested set for a matching tag and valid bit.
+ * an addressParts struct using parseAddress, then access the selected set
+ * with accessSet. This is the default (bit selection) retrieve function.
+ */
+void retrieveCacheLine(cache *c, unsigned long long addr) {
+    addressParts parts = parseAddress(addr, indexBits, offsetBits);
+    accessSet(c, &c->sets[parts.idx], parts.tag, addr);
+}
+
+/*
+ * Function:	retrieveCacheLineXor
+ * Input:	cache *<c>
+ * 		unsigned long long <addr>
+ * Output:	void
+ * Description:
+ * Retrieve function for INDEX_XOR. Same as retrieveCacheLine with the set
+ * index computed by parseAddressXor.
+ */
+void retrieveCacheLineXor(cache *c, unsigned long long addr) {
+    addressParts parts = parseAddressXor(addr, indexBits, offsetBits);
+    accessSet(c, &c->sets[parts.idx], parts.tag, addr);
+}
+
+/*
+ * Function:	retrieveCacheLinePrime
+ * Input:	cache *<c>
+ * 		unsigned long long <addr>
+ * Output:	void
+ * Description:
+ * Retrieve function for INDEX_PRIME. Same as retrieveCacheLine with the set
+ * index computed by parseAddressPrime.
+ */
+void retrieveCacheLinePrime(cache *c, unsigned long long addr) {
+    addressParts parts = parseAddressPrime(addr, c->primeSets, offsetBits);
+    accessSet(c, &c->sets[parts.idx], parts.tag, addr);
+}
+
+/*
+ * Function:	accessSet
+ * Input:	cache *<c>
+ * 		set *<curSet> - set selected by the index function
+ * 		unsigned long long <tag>
+ * 		unsigned long long <addr>
+ * Output:	void
+ * Description:
+ * Increment the LRU accessCounter. Search <curSet> for a matching tag and valid bit.
  * If yes, 
- * 	increment hits, update accessTime for that line, and return. 
+ * 	increment hits (or count a sector miss if the sector of <addr> is
+ * 	not present yet), update accessTime for that line, and return.  
  *
  * Else, 
  * 	increment misses and search for an empty line (invalid bit) in the set to
- * 	insert the accessed line into. 
+ * 	insert the accessed line into, among the ways the current tenant may fill.
  * 	If successful,
  * 		update the cache line with address data, including valid bit,
  *		tag, and accessTime and return
@@ -204,16 +769,23 @@ void runTrace(cache *c) {
  *		Increment evictions and call getEvictLine to find oldest entry in
  *		the set. Replace the found line with the accessed line.
  */
-void retrieveCacheLine(cache *c, unsigned long long addr) {
-    addressParts parts = parseAddress(addr, indexBits, offsetBits);
-    set * curSet = &c->sets[parts.idx];
+void accessSet(cache *c, set *curSet, unsigned long long tag, unsigned long long addr) {
+    unsigned long long blockAddr = addr >> offsetBits;
     c->accessCounter++;
 
+    if (c->hashed) {
+	retrieveCacheLineHashed(c, curSet, tag, addr);
+	return;
+    }
+
     for (int i = 0; i < lineCount; i++) {
     	line *line_ = &curSet->lines[i];
-	if (line_->valid && line_->tag == parts.tag) {
-	    if (verboseOutput) printf(" hit");
-	    hits++;
+	if (line_->valid && line_->tag == tag) {
+	    if (accessSector(c, line_, addr)) {
+		if (verboseOutput) printf(" hit");
+		hits++;
+		recordHit(c, blockAddr);
+	    }
 	    line_->accessTime = c->accessCounter;
 	    return;
 	}
@@ -221,12 +793,16 @@ void retrieveCacheLine(cache *c, unsigned long long addr) {
 
     if (verboseOutput) printf(" miss");
     misses++;
+    recordMiss(c, blockAddr);
 
     for (int i = 0; i < lineCount; i++) {
     	line *line_ = &curSet->lines[i];
-	if (!line_->valid) {
+	if (!line_->valid && WAY_ALLOWED(wayMask[curTenant], i)) {
 	    line_->valid = true;
-	    line_->tag = parts.tag;
+	    line_->tag = tag;
+	    line_->block = blockAddr;
+	    fillSectors(line_, addr);
+	    line_->tenant = curTenant;
 	    line_->accessTime = c->accessCounter;
 	    return;
 	}
@@ -237,12 +813,208 @@ void retrieveCacheLine(cache *c, unsigned long long addr) {
 
     int victimIndex = getEvictLine(curSet);
     line *victimLine = &curSet->lines[victimIndex];
-    victimLine->tag = parts.tag;
+    if (victimLine->tenant != curTenant)
+	tenantCrossEvictions[curTenant]++;
+    recordEviction(c, victimLine);
+    victimLine->tag = tag;
+    victimLine->block = blockAddr;
+    fillSectors(victimLine, addr);
+    victimLine->tenant = curTenant;
     victimLine->accessTime = c->accessCounter;
     victimLine->valid = true;
 }
 
 
+/*
+ * Function:	retrieveCacheLineHashed
+ * Input:	cache *<c>
+ * 		set *<curSet> - set selected by the address index bits
+ * 		unsigned long long <tag>
+ * 		unsigned long long <addr>
+ * Output:	void
+ * Description:
+ * Same behaviour as accessSet, used when the associativity is above
+ * HASH_LOOKUP_THRESHOLD. The tag is looked up through the set's hash table
+ * and the LRU order is kept as a doubly linked list, so hits, fills and
+ * evictions are all O(1) instead of O(E).
+ */
+void retrieveCacheLineHashed(cache *c, set *curSet, unsigned long long tag, unsigned long long addr) {
+    unsigned long long blockAddr = addr >> offsetBits;
+    int lineIdx = hashFind(curSet, tag);
+
+    if (lineIdx != HASH_EMPTY) {
+	if (accessSector(c, &curSet->lines[lineIdx], addr)) {
+	    if (verboseOutput) printf(" hit");
+	    hits++;
+	    recordHit(c, blockAddr);
+	}
+	curSet->lines[lineIdx].accessTime = c->accessCounter;
+	lruUnlink(curSet, lineIdx);
+	lruPushFront(curSet, lineIdx);
+	return;
+    }
+
+    if (verboseOutput) printf(" miss");
+    misses++;
+    recordMiss(c, blockAddr);
+
+    if (curSet->used < lineCount) {
+	lineIdx = curSet->used++;
+    }
+    else {
+	if (verboseOutput) printf(" eviction");
+	evictions++;
+	lineIdx = getEvictLine(curSet);
+	if (curSet->lines[lineIdx].tenant != curTenant)
+	    tenantCrossEvictions[curTenant]++;
+	recordEviction(c, &curSet->lines[lineIdx]);
+	hashRemove(curSet, curSet->lines[lineIdx].tag);
+	lruUnlink(curSet, lineIdx);
+    }
+
+    line *line_ = &curSet->lines[lineIdx];
+    line_->valid = true;
+    line_->tag = tag;
+    line_->block = blockAddr;
+    fillSectors(line_, addr);
+    line_->tenant = curTenant;
+    line_->accessTime = c->accessCounter;
+    hashInsert(curSet, tag, lineIdx);
+    lruPushFront(curSet, lineIdx);
+}
+
+/*
+ * Function:	hashSlot
+ * Input:	set *<set_>
+ * 		unsigned long long <tag>
+ * Output:	unsigned int - home slot of <tag> in the set's hash table
+ * Description:
+ * Multiplicative hash of <tag>, folded so the high bits of the product also
+ * affect the slot.
+ */
+unsigned int hashSlot(set *set_, unsigned long long tag) {
+    unsigned int h = (unsigned int) (tag ^ (tag >> 32)) * 0x9E3779B1u;
+    h ^= h >> 16;
+    return h & (unsigned int) set_->hashMask;
+}
+
+/*
+ * Function:	hashFind
+ * Input:	set *<set_>
+ * 		unsigned long long <tag>
+ * Output:	int - index of the line holding <tag>, or HASH_EMPTY
+ * Description:
+ * Linear probe the set's hash table starting at the slot <tag> hashes to.
+ */
+int hashFind(set *set_, unsigned long long tag) {
+    unsigned int slot = hashSlot(set_, tag);
+
+    while (set_->hashTable[slot] != HASH_EMPTY) {
+	int lineIdx = set_->hashTable[slot];
+	if (set_->lines[lineIdx].tag == tag)
+	    return lineIdx;
+	slot = (slot + 1) & (unsigned int) set_->hashMask;
+    }
+
+    return HASH_EMPTY;
+}
+
+/*
+ * Function:	hashInsert
+ * Input:	set *<set_>
+ * 		unsigned long long <tag>
+ * 		int <lineIdx> - line now holding <tag>
+ * Output:	void
+ * Description:
+ * Place <lineIdx> in the first empty slot at or after the home slot of <tag>.
+ * The table is sized to at least twice the associativity so there is always
+ * an empty slot.
+ */
+void hashInsert(set *set_, unsigned long long tag, int lineIdx) {
+    unsigned int slot = hashSlot(set_, tag);
+
+    while (set_->hashTable[slot] != HASH_EMPTY)
+	slot = (slot + 1) & (unsigned int) set_->hashMask;
+
+    set_->hashTable[slot] = lineIdx;
+}
+
+/*
+ * Function:	hashRemove
+ * Input:	set *<set_>
+ * 		unsigned long long <tag> - tag currently present in <set_>
+ * Output:	void
+ * Description:
+ * Remove <tag> from the hash table using backward shift deletion, so no
+ * tombstones are left behind to slow down later probes.
+ */
+void hashRemove(set *set_, unsigned long long tag) {
+    unsigned int mask = (unsigned int) set_->hashMask;
+    unsigned int hole = hashSlot(set_, tag);
+
+    while (set_->lines[set_->hashTable[hole]].tag != tag)
+	hole = (hole + 1) & mask;
+
+    unsigned int next = (hole + 1) & mask;
+    while (set_->hashTable[next] != HASH_EMPTY) {
+	unsigned int home = hashSlot(set_, set_->lines[set_->hashTable[next]].tag);
+	// Move the entry back if its home slot is not between the hole and it
+	if (((next - home) & mask) >= ((next - hole) & mask)) {
+	    set_->hashTable[hole] = set_->hashTable[next];
+	    hole = next;
+	}
+	next = (next + 1) & mask;
+    }
+
+    set_->hashTable[hole] = HASH_EMPTY;
+}
+
+/*
+ * Function:	lruUnlink
+ * Input:	set *<set_>
+ * 		int <lineIdx>
+ * Output:	void
+ * Description:
+ * Remove <lineIdx> from the set's LRU list.
+ */
+void lruUnlink(set *set_, int lineIdx) {
+    line *line_ = &set_->lines[lineIdx];
+
+    if (line_->lruPrev != HASH_EMPTY)
+	set_->lines[line_->lruPrev].lruNext = line_->lruNext;
+    else
+	set_->lruHead = line_->lruNext;
+
+    if (line_->lruNext != HASH_EMPTY)
+	set_->lines[line_->lruNext].lruPrev = line_->lruPrev;
+    else
+	set_->lruTail = line_->lruPrev;
+
+    line_->lruPrev = HASH_EMPTY;
+    line_->lruNext = HASH_EMPTY;
+}
+
+/*
+ * Function:	lruPushFront
+ * Input:	set *<set_>
+ * 		int <lineIdx> - line not currently in the LRU list
+ * Output:	void
+ * Description:
+ * Make <lineIdx> the most recently used line of the set.
+ */
+void lruPushFront(set *set_, int lineIdx) {
+    line *line_ = &set_->lines[lineIdx];
+
+    line_->lruPrev = HASH_EMPTY;
+    line_->lruNext = set_->lruHead;
+    if (set_->lruHead != HASH_EMPTY)
+	set_->lines[set_->lruHead].lruPrev = lineIdx;
+    else
+	set_->lruTail = lineIdx;
+    set_->lruHead = lineIdx;
+}
+
+
 /*
  * Function:	getEvictLine
  * Input:	set *<set_> - Set to evict a line from 
@@ -252,15 +1024,25 @@ void retrieveCacheLine(cache *c, unsigned long long addr) {
  * to find the lowest (oldest) accessTime. The index of the line with the lowest
  * accessTime is returned to the calling function to perform the cache eviction.
  * 
+ * Only ways the current tenant may fill (its wayMask) are considered.
+ * Sets using the hashed lookup already keep their lines in LRU order, so the
+ * tail of the list is returned directly.
+ *
  * NOTE: the index being returned IS NOT equivalent to the cache tag. The index
  * is merely where in the set the line to evict exists.
  */
 int getEvictLine(set *set_) {
-    int victim = 0;
-    unsigned long long lowest = set_->lines[0].accessTime;
+    if (set_->hashTable)
+	return set_->lruTail;
+
+    unsigned long long mask = wayMask[curTenant];
+    int victim = -1;
+    unsigned long long lowest = 0;
     
-    for(int i = 1; i < lineCount; i++) {
-    	if (set_->lines[i].accessTime < lowest) {
+    for(int i = 0; i < lineCount; i++) {
+	if (!WAY_ALLOWED(mask, i))
+	    continue;
+    	if (victim < 0 || set_->lines[i].accessTime < lowest) {
 	    lowest = set_->lines[i].accessTime;
 	    victim = i;
 	}	
@@ -287,11 +1069,418 @@ addressParts parseAddress(unsigned long long address, int s, int b) {
 
     parts.offset = (int) (address & offsetMask);
     parts.idx = (int) ((address >> b) & idxMask);
-    parts.tag = (int) (address >> (s + b));
+    parts.tag = address >> (s + b);
+
+    return parts;
+}
+
+/*
+ * Function:	parseAddressXor
+ * Input:	unsigned long long <address>
+ * 		int <s>
+ * 		int <b>
+ * Output:	addressParts - addressParts struct with parsed address data
+ * Description:
+ * Like parseAddress, but the set index is the XOR of every <s>-bit chunk of
+ * the block address instead of only the lowest chunk. The tag is unchanged,
+ * since the low chunk can still be recovered from the index and the tag.
+ */
+addressParts parseAddressXor(unsigned long long address, int s, int b) {
+    addressParts parts;
+
+    unsigned long long idxMask = (unsigned long long)((1 << s) - 1);
+    unsigned long long offsetMask = (unsigned long long)((1 << b) - 1);
+    unsigned long long blockAddr = address >> b;
+    unsigned long long idx = 0;
+
+    if (s > 0) {
+	for (unsigned long long x = blockAddr; x; x >>= s)
+	    idx ^= x & idxMask;
+    }
+
+    parts.offset = (int) (address & offsetMask);
+    parts.idx = (int) idx;
+    parts.tag = blockAddr >> s;
+
+    return parts;
+}
+
+/*
+ * Function:	parseAddressPrime
+ * Input:	unsigned long long <address>
+ * 		unsigned long long <sets> - prime number of sets in use
+ * 		int <b>
+ * Output:	addressParts - addressParts struct with parsed address data
+ * Description:
+ * Set index is the block address modulo <sets>, and the tag is the quotient.
+ */
+addressParts parseAddressPrime(unsigned long long address, unsigned long long sets, int b) {
+    addressParts parts;
+
+    unsigned long long offsetMask = (unsigned long long)((1 << b) - 1);
+    unsigned long long blockAddr = address >> b;
+
+    parts.offset = (int) (address & offsetMask);
+    parts.idx = (int) (blockAddr % sets);
+    parts.tag = blockAddr / sets;
 
     return parts;
 }
 
+/*
+ * Function:	setIndexBits, setIndexXor, setIndexPrime
+ * Input:	cache *<c>
+ * 		unsigned long long <addr>
+ * Output:	int - set <addr> maps to under the matching index function
+ * Description:
+ * Set index alone, for code outside the access path that has to agree with
+ * the cache's set mapping (the utility monitor).
+ */
+int setIndexBits(cache *c, unsigned long long addr) {
+    (void) c;
+    return parseAddress(addr, indexBits, offsetBits).idx;
+}
+
+int setIndexXor(cache *c, unsigned long long addr) {
+    (void) c;
+    return parseAddressXor(addr, indexBits, offsetBits).idx;
+}
+
+int setIndexPrime(cache *c, unsigned long long addr) {
+    return parseAddressPrime(addr, c->primeSets, offsetBits).idx;
+}
+
+/*
+ * Function:	skewIndex
+ * Input:	unsigned long long <blockAddr> - address with offset bits removed
+ * 		int <way>
+ * 		int <s>
+ * Output:	int - set index of <blockAddr> within <way>
+ * Description:
+ * Per-way hash used by INDEX_SKEW. Every way multiplies the block address by
+ * its own odd constant and keeps the top <s> bits, so two blocks that conflict
+ * in one way are unlikely to conflict in another.
+ */
+int skewIndex(unsigned long long blockAddr, int way, int s) {
+    if (s == 0)
+	return 0;
+
+    unsigned long long mult = 0x9E3779B97F4A7C15ULL + 2ULL * (unsigned long long) way * 0xBF58476D1CE4E5B9ULL;
+    unsigned long long h = (blockAddr ^ (blockAddr >> 29)) * mult;
+    return (int) (h >> (64 - s));
+}
+
+/*
+ * Function:	retrieveCacheLineSkewed
+ * Input:	cache *<c>
+ * 		unsigned long long <addr>
+ * Output:	void
+ * Description:
+ * Retrieve function for INDEX_SKEW. Way <w> of the cache is indexed by
+ * skewIndex(block, w), so a block has one candidate line in every way, each
+ * in a different set. The whole block address is kept as the tag. On a miss
+ * the first invalid candidate is filled, otherwise the least recently used
+ * candidate is evicted. Only ways in the current tenant's mask are
+ * candidates for the fill.
+ */
+void retrieveCacheLineSkewed(cache *c, unsigned long long addr) {
+    unsigned long long blockAddr = addr >> offsetBits;
+    line *victimLine = NULL;
+    c->accessCounter++;
+
+    for (int w = 0; w < lineCount; w++) {
+	line *line_ = &c->sets[skewIndex(blockAddr, w, indexBits)].lines[w];
+	if (line_->valid && line_->tag == blockAddr) {
+	    if (accessSector(c, line_, addr)) {
+		if (verboseOutput) printf(" hit");
+		hits++;
+		recordHit(c, blockAddr);
+	    }
+	    line_->accessTime = c->accessCounter;
+	    return;
+	}
+	if (!WAY_ALLOWED(wayMask[curTenant], w))
+	    continue;
+	if (!victimLine || (victimLine->valid &&
+	    (!line_->valid || line_->accessTime < victimLine->accessTime)))
+	    victimLine = line_;
+    }
+
+    if (verboseOutput) printf(" miss");
+    misses++;
+    recordMiss(c, blockAddr);
+
+    if (victimLine->valid) {
+	if (verboseOutput) printf(" eviction");
+	evictions++;
+	if (victimLine->tenant != curTenant)
+	    tenantCrossEvictions[curTenant]++;
+	recordEviction(c, victimLine);
+    }
+
+    victimLine->valid = true;
+    victimLine->tag = blockAddr;
+    victimLine->block = blockAddr;
+    fillSectors(victimLine, addr);
+    victimLine->tenant = curTenant;
+    victimLine->accessTime = c->accessCounter;
+}
+
+/*
+ * Function:	recordHit
+ * Input:	cache *<c>
+ * 		unsigned long long <blockAddr> - block that hit in the main cache
+ * Output:	void
+ * Description:
+ * With the miss buffer enabled, a hit on a block whose fill is still
+ * outstanding is really a secondary miss merged into that MSHR, so it is
+ * counted in mshrMerges.
+ */
+void recordHit(cache *c, unsigned long long blockAddr) {
+    for (int i = 0; i < mshrCount; i++) {
+	if (c->mshrs[i].block == blockAddr && c->mshrs[i].readyTime > c->accessCounter) {
+	    if (verboseOutput) printf(" mshr-merge");
+	    mshrMerges++;
+	    return;
+	}
+    }
+}
+
+/*
+ * Function:	recordMiss
+ * Input:	cache *<c>
+ * 		unsigned long long <blockAddr> - block that missed in the main cache
+ * Output:	void
+ * Description:
+ * Look for <blockAddr> in the victim cache. A victim hit is counted in
+ * victimHits and removes the block from the victim cache, since it moves back
+ * into the main cache. Otherwise the miss goes to memory and takes an MSHR.
+ */
+void recordMiss(cache *c, unsigned long long blockAddr) {
+    c->swapPending = false;
+
+    if (victimLineCount > 0 && victimProbe(c, blockAddr)) {
+	if (verboseOutput) printf(" victim-hit");
+	victimHits++;
+	c->swapPending = true;
+	return;
+    }
+
+    if (mshrCount > 0)
+	mshrAllocate(c, blockAddr);
+}
+
+/*
+ * Function:	recordEviction
+ * Input:	cache *<c>
+ * 		line *<victimLine> - valid line about to be replaced
+ * Output:	void
+ * Description:
+ * Write back the dirty sectors of the evicted line, then move the block
+ * into the victim cache. If the miss that caused the eviction was itself
+ * served by the victim cache, the two blocks have traded places and the
+ * access is counted as a swap.
+ */
+void recordEviction(cache *c, line *victimLine) {
+    int sectorShift = sectorBits >= 0 ? sectorBits : offsetBits;
+    bytesWrittenBack += (unsigned long long) __builtin_popcountll(victimLine->sectorDirty) << sectorShift;
+
+    if (victimLineCount == 0)
+	return;
+
+    victimInsert(c, victimLine->block);
+    if (c->swapPending) {
+	if (verboseOutput) printf(" swap");
+	swaps++;
+	c->swapPending = false;
+    }
+}
+
+/*
+ * Function:	victimProbe
+ * Input:	cache *<c>
+ * 		unsigned long long <blockAddr>
+ * Output:	bool - true if <blockAddr> was in the victim cache
+ * Description:
+ * Search the victim cache for <blockAddr> and invalidate it if found.
+ */
+bool victimProbe(cache *c, unsigned long long blockAddr) {
+    for (int i = 0; i < victimLineCount; i++) {
+	line *line_ = &c->victim.lines[i];
+	if (line_->valid && line_->block == blockAddr) {
+	    line_->valid = false;
+	    return true;
+	}
+    }
+
+    return false;
+}
+
+/*
+ * Function:	victimInsert
+ * Input:	cache *<c>
+ * 		unsigned long long <blockAddr> - block evicted from the main cache
+ * Output:	void
+ * Description:
+ * Place <blockAddr> in the first invalid victim cache line, or replace the
+ * least recently inserted one.
+ */
+void victimInsert(cache *c, unsigned long long blockAddr) {
+    line *target = &c->victim.lines[0];
+
+    for (int i = 0; i < victimLineCount; i++) {
+	line *line_ = &c->victim.lines[i];
+	if (!line_->valid) {
+	    target = line_;
+	    break;
+	}
+	if (line_->accessTime < target->accessTime)
+	    target = line_;
+    }
+
+    target->valid = true;
+    target->block = blockAddr;
+    target->accessTime = c->accessCounter;
+}
+
+/*
+ * Function:	mshrAllocate
+ * Input:	cache *<c>
+ * 		unsigned long long <blockAddr> - block fetched from memory
+ * Output:	void
+ * Description:
+ * Take an MSHR for <blockAddr> until missLatency accesses from now. If every
+ * MSHR is still busy the miss stalls: it is counted in mshrStalls and takes
+ * the entry that frees up first, starting its fill once that one completes.
+ */
+void mshrAllocate(cache *c, unsigned long long blockAddr) {
+    mshrEntry *target = &c->mshrs[0];
+
+    for (int i = 0; i < mshrCount; i++) {
+	if (c->mshrs[i].readyTime <= c->accessCounter) {
+	    target = &c->mshrs[i];
+	    break;
+	}
+	if (c->mshrs[i].readyTime < target->readyTime)
+	    target = &c->mshrs[i];
+    }
+
+    unsigned long long start = c->accessCounter;
+    if (target->readyTime > c->accessCounter) {
+	if (verboseOutput) printf(" mshr-stall");
+	mshrStalls++;
+	start = target->readyTime;
+    }
+
+    target->block = blockAddr;
+    target->readyTime = start + (unsigned long long) missLatency;
+}
+
+/*
+ * Function:	printVictimSummary
+ * Input:	void
+ * Output:	void
+ * Description:
+ * Print the victim cache and miss buffer counters. Misses served by the
+ * victim cache are still counted as misses in the main summary.
+ */
+void printVictimSummary() {
+    if (victimLineCount > 0)
+	printf("victim-hits:%d swaps:%d memory-misses:%d\n", victimHits, swaps, misses - victimHits);
+    if (mshrCount > 0)
+	printf("mshr-merges:%d mshr-stalls:%d\n", mshrMerges, mshrStalls);
+}
+
+/*
+ * Function:	sectorBit
+ * Input:	unsigned long long <addr>
+ * Output:	unsigned long long - bit of the sector holding <addr> in the
+ * 		sectorValid and sectorDirty bitmaps
+ */
+unsigned long long sectorBit(unsigned long long addr) {
+    if (sectorBits < 0)
+	return 1;
+
+    unsigned long long offset = addr & ((1ULL << offsetBits) - 1);
+    return 1ULL << (offset >> sectorBits);
+}
+
+/*
+ * Function:	accessSector
+ * Input:	cache *<c>
+ * 		line *<line_> - valid line whose tag matched <addr>
+ * 		unsigned long long <addr>
+ * Output:	bool - true if the sector of <addr> was already present
+ * Description:
+ * Mark the sector dirty on stores. If the sector has not been fetched yet
+ * this is a sector miss: it is counted as a miss (and in sectorMisses), the
+ * sector is fetched and made valid, and false is returned.
+ */
+bool accessSector(cache *c, line *line_, unsigned long long addr) {
+    unsigned long long bit = sectorBit(addr);
+
+    if (curWrite)
+	line_->sectorDirty |= bit;
+    if (line_->sectorValid & bit)
+	return true;
+
+    if (verboseOutput) printf(" sector-miss");
+    misses++;
+    sectorMisses++;
+    bytesFetched += 1ULL << (sectorBits >= 0 ? sectorBits : offsetBits);
+    line_->sectorValid |= bit;
+    recordMiss(c, addr >> offsetBits);
+    return false;
+}
+
+/*
+ * Function:	fillSectors
+ * Input:	line *<line_> - line just allocated for <addr>
+ * 		unsigned long long <addr>
+ * Output:	void
+ * Description:
+ * Start the new line with only the sector of <addr> present (the whole
+ * line when not sectored), dirty if the access is a store.
+ */
+void fillSectors(line *line_, unsigned long long addr) {
+    unsigned long long bit = sectorBit(addr);
+
+    tagMisses++;
+    bytesFetched += 1ULL << (sectorBits >= 0 ? sectorBits : offsetBits);
+    line_->sectorValid = bit;
+    line_->sectorDirty = curWrite ? bit : 0;
+}
+
+/*
+ * Function:	printSectorSummary
+ * Input:	void
+ * Output:	void
+ * Description:
+ * Print the sector statistics. Misses in the main summary are the sum of
+ * tag misses and sector misses.
+ */
+void printSectorSummary() {
+    printf("tag-misses:%d sector-misses:%d bytes-fetched:%llu bytes-written-back:%llu\n",
+	   tagMisses, sectorMisses, bytesFetched, bytesWrittenBack);
+}
+
+/*
+ * Function:	parseIndexFunction
+ * Input:	const char *<name> - bits, xor, prime or skew
+ * Output:	int - matching INDEX_* value, or -1 if <name> is unknown
+ */
+int parseIndexFunction(const char *name) {
+    if (strcmp(name, "bits") == 0)
+	return INDEX_BITS;
+    if (strcmp(name, "xor") == 0)
+	return INDEX_XOR;
+    if (strcmp(name, "prime") == 0)
+	return INDEX_PRIME;
+    if (strcmp(name, "skew") == 0)
+	return INDEX_SKEW;
+    return -1;
+}
+
 /*
  * Function: 	createCache
  * Input:	int <s> - number of set index bits
@@ -306,6 +1495,15 @@ addressParts parseAddress(unsigned long long address, int s, int b) {
  * 	tag		= -1
  * 	block		= 0
  * 	accessTime	= 0
+ * When <E> is above HASH_LOOKUP_THRESHOLD each set also gets an empty hash
+ * table of at least 2*E slots and an empty LRU list. Skewed and partitioned
+ * caches restrict which ways a block may use, so they never use the hash
+ * table.
+ *
+ * The victim cache and MSHRs are allocated empty when enabled.
+ *
+ * The retrieve function matching indexFunction is picked here once, so the
+ * per-access path of each index function has no mode checks of its own.
  */
 cache* createCache(int s, int E, int b) {
     cache* c = malloc(sizeof(cache));
@@ -313,17 +1511,79 @@ cache* createCache(int s, int E, int b) {
     c->E = E;
     c->b = b;
     c->accessCounter = 0;
+    c->hashed = E > HASH_LOOKUP_THRESHOLD && indexFunction != INDEX_SKEW && !partitioned;
+
+    switch (indexFunction) {
+	case INDEX_XOR:
+	    c->retrieve = retrieveCacheLineXor;
+	    c->setIndex = setIndexXor;
+	    break;
+
+	case INDEX_PRIME:
+	    c->retrieve = retrieveCacheLinePrime;
+	    c->setIndex = setIndexPrime;
+	    break;
+
+	case INDEX_SKEW:
+	    c->retrieve = retrieveCacheLineSkewed;
+	    c->setIndex = NULL;
+	    break;
+
+	default:
+	    c->retrieve = retrieveCacheLine;
+	    c->setIndex = setIndexBits;
+	    break;
+    }
+
+    int hashSize = 1;
+    while (hashSize < 2 * E)
+	hashSize <<= 1;
 
     int S = 1 << s;
     c->sets = malloc((long unsigned int)S * sizeof(set));
 
+    c->swapPending = false;
+    c->victim.lines = calloc((long unsigned int)victimLineCount, sizeof(line));
+    c->victim.hashTable = NULL;
+    c->mshrs = calloc((long unsigned int)mshrCount, sizeof(mshrEntry));
+
+    // Largest prime number of sets that fits in the 2^s allocated
+    c->primeSets = (unsigned long long) S;
+    for (bool prime = false; !prime && c->primeSets > 2; ) {
+	prime = true;
+	for (unsigned long long d = 2; d * d <= c->primeSets; d++) {
+	    if (c->primeSets % d == 0) {
+		prime = false;
+		c->primeSets--;
+		break;
+	    }
+	}
+    }
+
     for (int i=0; i < S; i++) {
     	c->sets[i].lines = malloc((long unsigned int)E * sizeof(line));
 	for (int j = 0; j < E; j++) {
 	    c->sets[i].lines[j].valid = false;
-	    c->sets[i].lines[j].tag = -1;
+	    c->sets[i].lines[j].tag = (unsigned long long) -1;
 	    c->sets[i].lines[j].block = 0;
 	    c->sets[i].lines[j].accessTime = 0;
+	    c->sets[i].lines[j].tenant = 0;
+	    c->sets[i].lines[j].sectorValid = 0;
+	    c->sets[i].lines[j].sectorDirty = 0;
+	    c->sets[i].lines[j].lruPrev = HASH_EMPTY;
+	    c->sets[i].lines[j].lruNext = HASH_EMPTY;
+	}
+
+	c->sets[i].hashTable = NULL;
+	c->sets[i].hashMask = 0;
+	c->sets[i].lruHead = HASH_EMPTY;
+	c->sets[i].lruTail = HASH_EMPTY;
+	c->sets[i].used = 0;
+	if (c->hashed) {
+	    c->sets[i].hashTable = malloc((long unsigned int)hashSize * sizeof(int));
+	    c->sets[i].hashMask = hashSize - 1;
+	    for (int j = 0; j < hashSize; j++)
+		c->sets[i].hashTable[j] = HASH_EMPTY;
 	}
     }
 
@@ -338,16 +1598,20 @@ cache* createCache(int s, int E, int b) {
  * Description:
  * Take input argment <c> and deallocate memory used by the cache.
  * Deallocation occurs in the following order
- * 	> lines
+ * 	> lines (and hash table)
  * 	> sets
+ * 	> victim cache and MSHRs
  * 	> cache
  */
 void freeCache(cache* c) {
     int S = 1 << c->s;
     for (int i = 0; i < S; i++) {
     	free(c->sets[i].lines);
+	free(c->sets[i].hashTable);
     }
     free(c->sets);
+    free(c->victim.lines);
+    free(c->mshrs);
     free(c);
 }
 
@@ -360,13 +1624,16 @@ void freeCache(cache* c) {
  * 	> indexBits
  * 	> lineCount
  * 	> offsetBits
- * 	> traceFile
+ * 	> traceFiles
+ * 	> indexFunction
  */
 void printArgs() {
    printf("Set index bits:    %d\n", indexBits);
    printf("Lines per set:     %d\n", lineCount);
    printf("Block offset bits: %d\n", offsetBits);
-   printf("Trace file name:   %s\n", traceFile);
+   for (int i = 0; i < tenantCount; i++)
+       printf("Trace file name:   %s\n", traceFiles[i]);
+   printf("Index function:    %d\n", indexFunction);
 }
 
 /*
@@ -379,13 +1646,23 @@ void printArgs() {
  */
 void printHelp() {
 // Print help message
-   printf("Usage: ./csim -h -s <num> -E <num> -b <num> -t <file>\n");
+   printf("Usage: ./csim -h -s <num> -E <num> -b <num> -t <file> [-t <file>...] [-i <func>]\n");
+   printf("              [-m <mask,...> | -u] [-r <rr|time>] [-V <num>] [-Q <num> -L <num>]\n");
+   printf("              [-S <num>]\n");
    printf("Options:\n");
    printf("  -h\t     Print this help message.\n");
    printf("  -s <num>   Number of set index bits.\n");
    printf("  -E <num>   Number of lines per set.\n");
    printf("  -b <num>   Number of block offset bits.\n");
-   printf("  -t <file>  Trace file.\n\n");
+   printf("  -t <file>  Trace file. Repeat for one trace per tenant.\n");
+   printf("  -i <func>  Set index function: bits (default), xor, prime, skew.\n");
+   printf("  -m <masks> Comma separated hex way masks, one per tenant.\n");
+   printf("  -u         Utility-based way partitioning between tenants (not with -i skew).\n");
+   printf("  -r <mode>  Interleave tenants round-robin (rr, default) or by timestamp (time).\n");
+   printf("  -V <num>   Lines in a fully associative victim cache.\n");
+   printf("  -Q <num>   Number of MSHRs (miss buffer entries).\n");
+   printf("  -L <num>   Accesses a miss stays outstanding (default 20).\n");
+   printf("  -S <num>   Sector offset bits, splitting each line into 2^(b-S) sectors.\n\n");
    printf("Example:\n");
    printf("  linux>  ./csim -s 4 -E 1 -b 4 -t traces/yi.trace\n");
 }
@@ -0,0 +1,1274 @@
+/*
+ * planmodel.c - Analytical miss model for plan driven tiled transposes
+ *
+ * Times inside a tile follow PLAN_TRANSPOSE_BODY: each row of a tile w ints
+ * wide gets a span of 2w + 1 ticks, the element at position k of the row
+ * (after snake reversal) is read at 2k and written at 2k + 1, a deferred diagonal
+ * element is written at 2w, and with DIAG_ROWBUF all w reads come first,
+ * at k, followed by the writes at w + k.
+ *
+ * A tile touches a line of A on one row, as a run of reads, and a line of
+ * B once per row over a range of rows, at a position that only depends on
+ * the parity of the row (snake order) or on whether the row is the line's
+ * diagonal (DIAG_DEFER). Under LRU a touch misses exactly when E or more
+ * other lines of its set were touched since the line's previous touch, so
+ * per set and tile:
+ *
+ *   - the first touch of a line misses unless the line is cached and fewer
+ *     than E lines were used since, counting from its last use before the
+ *     tile and the first touches of the tile's other lines
+ *   - the reads of a run have at most one write between them, so they only
+ *     miss on a direct-mapped cache, once for every write of a B line of
+ *     the set that falls inside the run
+ *   - between consecutive touches of a B line, every other line of the set
+ *     is touched on a contiguous range of rows, or on every other row of
+ *     one, so the touches that miss are the rows covered by E or more of
+ *     these ranges, counted with one sweep over their end points
+ *
+ * The LRU state after the tile is the E lines with the latest last touch.
+ *
+ * Only the first touches depend on earlier tiles, and only through lines
+ * that straddle two tiles. The rest is a function of the tile's class: its
+ * size, where its rows start within a line and how far apart the sets of
+ * A and B are. A class is made of one footprint of A and one of B, which
+ * only depend on the tile's size and where A's, or B's, rows start, and
+ * whose sets overlap according to how far apart A and B are. Footprints
+ * and what each pair of overlapping sets adds are counted once per model
+ * and shared by every plan with the same in-tile order, so a tile that
+ * has been seen before costs a walk over its sets.
+ */
+#include <limits.h>
+#include <stdlib.h>
+#include "planmodel.h"
+
+/* Touches of one cache line by one row of A (or of B) inside a tile */
+typedef struct {
+    unsigned long long line;
+    unsigned long long first;	/* tile relative time of the first touch */
+    unsigned long long last;	/* tile relative time of the last touch */
+    unsigned int set;
+    int isB;
+    int fixed;	/* row i of A, or row j of B */
+    int lo, hi;	/* columns j of A, or rows i of A, touched */
+    int id;	/* index of the line among the lines of its set */
+} segment;
+
+/* A line of one set as seen by one tile */
+typedef struct {
+    unsigned long long line;
+    unsigned long long first, last;	/* tile relative */
+    unsigned long long stamp;	/* last use before the tile, 0 if not cached */
+    int isB;
+} lineInfo;
+
+/*
+ * Windows of a B line touched by one other line. Window u lies between the
+ * line's touches on rows u - 1 and u; the mark covers windows 2k + cls for
+ * k in lo..hi.
+ */
+typedef struct {
+    int cls;
+    int id;
+    int lo, hi;
+} mark;
+
+/* Tiles whose footprints only differ by a whole number of cache sizes */
+typedef struct {
+    int rows, cols;
+    int mode;	/* DIAG_NONE, or DIAG_DEFER or DIAG_ROWBUF where they change the timing */
+    int parity;	/* 0, or 1 + parity of the first row in snake order */
+    int diag;	/* ti - tj when mode is DIAG_DEFER */
+    unsigned long long phaseA, phaseB, sets;
+} tileClass;
+
+/* The lines of A, or of B, that a tile of a class touches, in the class's frame */
+typedef struct {
+    int rows, cols, mode, parity, diag;	/* as for the class */
+    int isB;
+    unsigned long long phase;	/* phaseA or phaseB */
+    size_t group, groups;	/* its sets in fpGroups */
+    unsigned int conflicts;	/* misses among its own lines */
+    unsigned int lines;
+    unsigned long long hash;
+} footprint;
+
+/* The segments of a footprint that share a set */
+typedef struct {
+    unsigned int set;	/* relative to the set of the footprint's first line */
+    unsigned int conflicts;	/* misses among the set's own lines */
+    size_t seg, segs;	/* in fpSegs, by line and then by first touch */
+    size_t line, lines;	/* in fpLines, the earliest first touch first */
+    size_t latest;	/* which of those is touched last */
+} fpGroup;
+
+/* What an A group and a B group that share a set add to their own conflict misses */
+typedef struct {
+    size_t ga, gb;	/* in fpGroups, plus one; 0 ga marks an empty slot */
+    unsigned int conflicts;
+} setPair;
+
+struct planModel {
+    int M, N;
+    unsigned long long baseA, baseB;
+    int s, E, b;
+    /* LRU state, line number per way (~0 when invalid) and last use */
+    unsigned long long *lines;
+    unsigned long long *stamps;
+    int *setHead, *setTail;
+    /* scratch for one tile, sized for maxSeg segments */
+    size_t maxSeg;
+    segment *seg;
+    int *segNext;
+    unsigned int *usedSets;
+    segment *group;
+    lineInfo *info;
+    mark *marks;
+    int *bounds;
+    /* footprints seen by any prediction so far, and their index by hash */
+    footprint *fps;
+    size_t fpCap, fpUsed;
+    size_t *fpIndex;	/* index + 1 into fps, 0 when empty */
+    size_t fpIndexCap;
+    lineInfo *fpLines;
+    size_t fpLinesUsed, fpLinesCap;
+    setPair *pairs;
+    size_t pairCap, pairUsed;
+    fpGroup *fpGroups;
+    size_t fpGroupsUsed, fpGroupsCap;
+    segment *fpSegs;
+    size_t fpSegsUsed, fpSegsCap;
+    int *slot;	/* per set, a group of the B footprint being merged, else -1 */
+};
+
+/* One prediction */
+typedef struct {
+    planModel *pm;
+    const trans_plan *p;
+    int M, N;
+    unsigned long long baseA, baseB;
+    int s, E, b;
+    unsigned long long rowSpan;
+    /* current tile */
+    int ti, tj, iend, jend;
+    int mode;	/* its class's diagonal handling */
+    unsigned long long tileBase;
+    unsigned long long lineA, lineB;	/* first lines of A and B in the tile */
+    unsigned long long frameA, frameB;	/* where A and B rows start in the class's frame */
+    /* copied from pm */
+    unsigned long long *lines;
+    unsigned long long *stamps;
+    segment *seg;
+    int *setHead, *setTail, *segNext;
+    unsigned int *usedSets;
+    size_t segCount, usedCount;
+    segment *group;
+    lineInfo *info;
+    mark *marks;
+    int *bounds;
+    int shared;	/* lines straddle tiles, so first touches need the LRU state */
+    unsigned int fills;	/* misses that found an empty line, when shared */
+    unsigned long long touched;	/* lines of the tiles so far, counting shared lines again */
+    planModelResult *res;
+} model;
+
+static unsigned long long rowPos(const model *m, int i, int j)
+{
+    int rev = m->p->order == TRAV_SNAKE && (i % 2);
+    return (unsigned long long)(rev ? m->jend - 1 - j : j - m->tj);
+}
+
+static unsigned long long readTime(const model *m, int i, int j)
+{
+    unsigned long long k = rowPos(m, i, j);
+    unsigned long long base = (unsigned long long)(i - m->ti) * m->rowSpan;
+
+    return base + (m->mode == DIAG_ROWBUF ? k : 2 * k);
+}
+
+static unsigned long long writeTime(const model *m, int i, int j)
+{
+    unsigned long long k = rowPos(m, i, j);
+    unsigned long long w = (unsigned long long)(m->jend - m->tj);
+    unsigned long long base = (unsigned long long)(i - m->ti) * m->rowSpan;
+
+    if (m->mode == DIAG_ROWBUF)
+        return base + w + k;
+    if (m->mode == DIAG_DEFER && i == j)
+        return base + 2 * w;
+    return base + 2 * k + 1;
+}
+
+/*
+ * addSegments - Split the run of ints lo..hi of one matrix row starting at
+ *     rowAddr into per-line segments and append them to their sets
+ */
+static void addSegments(model *m, unsigned long long rowAddr, int isB, int fixed, int lo, int hi)
+{
+    int k = lo;
+
+    while (k <= hi) {
+        unsigned long long addr = rowAddr + (unsigned long long)k * sizeof(int);
+        unsigned long long line = addr >> m->b;
+        unsigned long long next = (line + 1) << m->b;
+        int last = k + (int)((next - addr + sizeof(int) - 1) / sizeof(int)) - 1;
+        size_t n = m->segCount++;
+        segment *sg = &m->seg[n];
+
+        sg->line = line;
+        sg->set = (unsigned int)(line & ((1ULL << m->s) - 1));
+        sg->isB = isB;
+        sg->fixed = fixed;
+        sg->lo = k;
+        sg->hi = last < hi ? last : hi;
+        if (isB) {
+            sg->first = writeTime(m, sg->lo, fixed);
+            sg->last = writeTime(m, sg->hi, fixed);
+        } else {
+            unsigned long long t1 = readTime(m, fixed, sg->lo);
+            unsigned long long t2 = readTime(m, fixed, sg->hi);
+            sg->first = t1 < t2 ? t1 : t2;
+            sg->last = t1 < t2 ? t2 : t1;
+        }
+
+        m->segNext[n] = -1;
+        if (m->setHead[sg->set] < 0) {
+            m->setHead[sg->set] = (int)n;
+            m->usedSets[m->usedCount++] = sg->set;
+        } else {
+            m->segNext[m->setTail[sg->set]] = (int)n;
+        }
+        m->setTail[sg->set] = (int)n;
+        k = sg->hi + 1;
+    }
+}
+
+static int segmentCmp(const void *x, const void *y)
+{
+    const segment *a = x, *b = y;
+
+    if (a->line != b->line)
+        return a->line < b->line ? -1 : 1;
+    return a->first < b->first ? -1 : a->first > b->first;
+}
+
+static int markCmp(const void *x, const void *y)
+{
+    const mark *a = x, *b = y;
+
+    if (a->cls != b->cls)
+        return a->cls - b->cls;
+    if (a->id != b->id)
+        return a->id - b->id;
+    return a->lo - b->lo;
+}
+
+static int intCmp(const void *x, const void *y)
+{
+    int a = *(const int *)x, b = *(const int *)y;
+    return (a > b) - (a < b);
+}
+
+/*
+ * Sets rarely hold more than a handful of segments, where insertion sort
+ * beats qsort's call overhead by a wide margin
+ */
+#define SORT_SMALL 24
+
+static void sortSegments(segment *a, size_t n)
+{
+    if (n > SORT_SMALL) {
+        qsort(a, n, sizeof(segment), segmentCmp);
+        return;
+    }
+    for (size_t k = 1; k < n; k++) {
+        segment tmp = a[k];
+        size_t x = k;
+        for (; x > 0 && segmentCmp(&a[x - 1], &tmp) > 0; x--)
+            a[x] = a[x - 1];
+        a[x] = tmp;
+    }
+}
+
+static void sortMarks(mark *a, size_t n)
+{
+    if (n > SORT_SMALL) {
+        qsort(a, n, sizeof(mark), markCmp);
+        return;
+    }
+    for (size_t k = 1; k < n; k++) {
+        mark tmp = a[k];
+        size_t x = k;
+        for (; x > 0 && markCmp(&a[x - 1], &tmp) > 0; x--)
+            a[x] = a[x - 1];
+        a[x] = tmp;
+    }
+}
+
+static void sortInts(int *a, size_t n)
+{
+    if (n > SORT_SMALL) {
+        qsort(a, n, sizeof(int), intCmp);
+        return;
+    }
+    for (size_t k = 1; k < n; k++) {
+        int tmp = a[k];
+        size_t x = k;
+        for (; x > 0 && a[x - 1] > tmp; x--)
+            a[x] = a[x - 1];
+        a[x] = tmp;
+    }
+}
+
+/*
+ * addMark - Mark windows u1, u1 + step, ..., u2 of a B line whose windows
+ *     run from lo to hi as touched by line id
+ */
+static void addMark(mark *marks, size_t *nm, int id, int u1, int u2, int step, int lo, int hi)
+{
+    if (u1 < lo)
+        u1 += (lo - u1 + step - 1) / step * step;
+    if (u2 > hi)
+        u2 -= (u2 - hi + step - 1) / step * step;
+    for (int cls = 0; cls < 2 && u1 <= u2; cls++) {
+        int a = u1 + ((u1 & 1) != cls);
+        int z = u2 - ((u2 & 1) != cls);
+        if (step == 2 && (u1 & 1) != cls)
+            continue;
+        if (a > z)
+            continue;
+        marks[*nm].cls = cls;
+        marks[*nm].id = id;
+        marks[*nm].lo = a >> 1;
+        marks[*nm].hi = z >> 1;
+        (*nm)++;
+    }
+}
+
+/*
+ * windowMisses - Touches of the B segment x after its first that find E or
+ *     more other lines of the set used since the previous one
+ */
+static unsigned int windowMisses(model *m, const segment *seg, size_t n, const segment *x)
+{
+    mark *marks = m->marks;
+    size_t nm = 0, nb = 0;
+    unsigned int misses = 0;
+    int lo = x->lo + 1, hi = x->hi;
+
+    for (size_t k = 0; k < n; k++) {
+        const segment *y = &seg[k];
+        if (y->id == x->id)
+            continue;
+        if (!y->isB) {
+            // a run of reads on row r falls in window r, r + 1 or both
+            if (y->fixed < x->lo || y->fixed > x->hi)
+                continue;
+            unsigned long long t = writeTime(m, y->fixed, x->fixed);
+            if (y->first < t)
+                addMark(marks, &nm, y->id, y->fixed, y->fixed, 1, lo, hi);
+            if (y->last > t)
+                addMark(marks, &nm, y->id, y->fixed + 1, y->fixed + 1, 1, lo, hi);
+            continue;
+        }
+
+        // a write on row r falls in window r if it comes before x's on that row, else r + 1
+        int r1 = y->lo > x->lo ? y->lo : x->lo;
+        int r2 = y->hi < x->hi ? y->hi : x->hi;
+        int before[2], special[3], ns = 0;
+        if (r1 > r2)
+            continue;
+        for (int par = 0; par < 2; par++)
+            before[par] = rowPos(m, par, y->fixed) < rowPos(m, par, x->fixed);
+        if (m->mode == DIAG_DEFER) {
+            if (x->fixed >= r1 && x->fixed <= r2)
+                special[ns++] = x->fixed;
+            if (y->fixed >= r1 && y->fixed <= r2 && y->fixed != x->fixed)
+                special[ns++] = y->fixed;
+            if (ns == 2 && special[0] > special[1]) {
+                int tmp = special[0];
+                special[0] = special[1];
+                special[1] = tmp;
+            }
+        }
+        special[ns] = r2 + 1;
+        for (int e = 0, r = r1; e <= ns; r = special[e++] + 1) {
+            int end = special[e] - 1;
+            if (r <= end && before[0] == before[1]) {
+                addMark(marks, &nm, y->id, r + !before[0], end + !before[0], 1, lo, hi);
+            } else if (r <= end) {
+                for (int par = 0; par < 2; par++) {
+                    int f = r + ((r & 1) != par);
+                    int l = end - ((end & 1) != par);
+                    if (f <= l)
+                        addMark(marks, &nm, y->id, f + !before[par], l + !before[par], 2, lo, hi);
+                }
+            }
+            if (e < ns) {
+                int row = special[e];
+                int u = row + (writeTime(m, row, y->fixed) > writeTime(m, row, x->fixed));
+                addMark(marks, &nm, y->id, u, u, 1, lo, hi);
+            }
+        }
+    }
+    if (nm < (size_t)m->E)
+        return 0;
+
+    // merge the marks of each line, then count the windows covered E times
+    sortMarks(marks, nm);
+    for (int cls = 0; cls < 2; cls++) {
+        size_t k = 0;
+        nb = 0;
+        while (k < nm) {
+            if (marks[k].cls != cls) {
+                k++;
+                continue;
+            }
+            int id = marks[k].id, a = marks[k].lo, z = marks[k].hi;
+            for (k++; k < nm && marks[k].cls == cls && marks[k].id == id && marks[k].lo <= z + 1; k++)
+                z = marks[k].hi > z ? marks[k].hi : z;
+            m->bounds[nb++] = 2 * a;	/* opening */
+            m->bounds[nb++] = 2 * (z + 1) + 1;	/* closing */
+        }
+        if (nb < 2 * (size_t)m->E)
+            continue;
+        sortInts(m->bounds, nb);
+        int cover = 0, from = 0;
+        for (size_t e = 0; e < nb; e++) {
+            int at = m->bounds[e] >> 1;
+            if (cover >= m->E)
+                misses += (unsigned int)(at - from);
+            cover += (m->bounds[e] & 1) ? -1 : 1;
+            from = at;
+        }
+    }
+    return misses;
+}
+
+/*
+ * touchedBetween - Whether segment y touches its line strictly between the
+ *     tile relative times from and to
+ */
+static int touchedBetween(const model *m, const segment *y, unsigned long long from, unsigned long long to)
+{
+    if (y->last <= from || y->first >= to)
+        return 0;
+    if (!y->isB) {
+        // reads are evenly spaced over first..last
+        unsigned long long step = m->mode == DIAG_ROWBUF ? 1 : 2;
+        unsigned long long t = y->first;
+        if (t <= from)
+            t += (from - t) / step * step + step;
+        return t < to && t <= y->last;
+    }
+
+    // one write per row: any row strictly inside the gap, else check its two end rows
+    int rf = m->ti + (int)(from / m->rowSpan), rt = m->ti + (int)(to / m->rowSpan);
+    int lo = y->lo > rf + 1 ? y->lo : rf + 1, hi = y->hi < rt - 1 ? y->hi : rt - 1;
+    if (lo <= hi)
+        return 1;
+    for (int r = rf; r <= rt; r += rt > rf ? rt - rf : 1) {
+        unsigned long long t = writeTime(m, r, y->fixed);
+        if (r >= y->lo && r <= y->hi && t > from && t < to)
+            return 1;
+    }
+    return 0;
+}
+
+/*
+ * numberLines - Give every line of the segments of a set, which come line
+ *     by line, one entry with its first and last touch, at lineA or lineB
+ *     plus the segments' line. Returns the number of lines.
+ */
+static size_t numberLines(model *m, segment *seg, size_t n, unsigned long long lineA, unsigned long long lineB)
+{
+    lineInfo *info = m->info;
+    size_t nl = 0;
+
+    for (size_t k = 0; k < n; k++) {
+        unsigned long long line = (seg[k].isB ? lineB : lineA) + seg[k].line;
+        if (nl == 0 || info[nl - 1].line != line || info[nl - 1].isB != seg[k].isB) {
+            info[nl].line = line;
+            info[nl].first = seg[k].first;
+            info[nl].last = seg[k].last;
+            info[nl].stamp = 0;
+            info[nl].isB = seg[k].isB;
+            nl++;
+        } else if (seg[k].last > info[nl - 1].last) {
+            info[nl - 1].last = seg[k].last;
+        }
+        seg[k].id = (int)nl - 1;
+    }
+    return nl;
+}
+
+/*
+ * conflictMisses - Misses of a set after the first touch of each line.
+ *     These only depend on the tile's footprint, not on the cache state.
+ */
+static unsigned int conflictMisses(model *m, const segment *seg, size_t n, size_t nl)
+{
+    unsigned int misses = 0;
+
+    // fewer than E other lines can never push a line out
+    if (nl <= (size_t)m->E)
+        return 0;
+
+    // later segments of a line: lines touched in the gap since the previous one
+    for (size_t k = 1; k < n; k++) {
+        int used = 0, prev = -1;
+        if (seg[k].id != seg[k - 1].id || seg[k].first <= seg[k - 1].last)
+            continue;
+        for (size_t z = 0; z < n && used < m->E; z++) {
+            if (seg[z].id == seg[k].id || seg[z].id == prev)
+                continue;
+            if (touchedBetween(m, &seg[z], seg[k - 1].last, seg[k].first)) {
+                used++;
+                prev = seg[z].id;
+            }
+        }
+        misses += used >= m->E;
+    }
+
+    // runs of reads split by writes, on direct-mapped caches only
+    if (m->E == 1 && m->mode != DIAG_ROWBUF) {
+        for (size_t a = 0; a < n; a++) {
+            if (seg[a].isB || seg[a].first == seg[a].last)
+                continue;
+            for (size_t k = 0; k < n; k++) {
+                if (!seg[k].isB || seg[k].id == seg[a].id ||
+                    seg[a].fixed < seg[k].lo || seg[a].fixed > seg[k].hi)
+                    continue;
+                unsigned long long t = writeTime(m, seg[a].fixed, seg[k].fixed);
+                misses += t > seg[a].first && t < seg[a].last;
+            }
+        }
+    }
+
+    // repeated writes to each B line
+    for (size_t k = 0; k < n; k++) {
+        if (seg[k].isB && seg[k].hi > seg[k].lo)
+            misses += windowMisses(m, seg, n, &seg[k]);
+    }
+    return misses;
+}
+
+/*
+ * directFirstTouches - firstTouches on a direct-mapped cache, where only the
+ *     set's earliest line can find itself still cached and the latest one
+ *     is what stays
+ */
+static unsigned int directFirstTouches(model *m, unsigned int set, unsigned long long earliest,
+                                       unsigned long long latest, unsigned long long last, size_t nl)
+{
+    unsigned int misses = (unsigned int)nl - (m->lines[set] == earliest);
+
+    m->fills += m->lines[set] == ~0ULL;
+    m->lines[set] = latest;
+    m->stamps[set] = m->tileBase + last;
+    return misses;
+}
+
+/*
+ * firstTouches - Misses of the first touch of each of the nl lines of a
+ *     set, then the set's LRU state after the tile
+ */
+static unsigned int firstTouches(model *m, unsigned int set, lineInfo *info, size_t nl)
+{
+    if (m->E == 1) {
+        size_t earliest = 0, latest = 0;
+        for (size_t x = 1; x < nl; x++) {
+            if (info[x].first < info[earliest].first)
+                earliest = x;
+            if (info[x].last > info[latest].last)
+                latest = x;
+        }
+        return directFirstTouches(m, set, info[earliest].line, info[latest].line, info[latest].last, nl);
+    }
+
+    unsigned long long *lines = &m->lines[(size_t)set * (size_t)m->E];
+    unsigned long long *stamps = &m->stamps[(size_t)set * (size_t)m->E];
+    unsigned int misses = 0;
+    int valid = 0, inTile = 0, after;
+
+    for (int w = 0; w < m->E; w++) {
+        if (lines[w] == ~0ULL)
+            continue;
+        valid++;
+        for (size_t x = 0; x < nl; x++) {
+            if (info[x].line == lines[w]) {
+                info[x].stamp = stamps[w];
+                break;
+            }
+        }
+    }
+
+    // lines used since the last use, before and in the tile
+    for (size_t x = 0; x < nl; x++) {
+        int used = 0;
+        if (info[x].stamp == 0) {
+            misses++;
+            continue;
+        }
+        for (int w = 0; w < m->E; w++)
+            used += lines[w] != ~0ULL && stamps[w] > info[x].stamp;
+        for (size_t z = 0; z < nl && used < m->E; z++)
+            used += info[z].first < info[x].first && info[z].stamp <= info[x].stamp;
+        misses += used >= m->E;
+    }
+
+    // the E most recently used lines stay: the tile's, by last touch, then older ones
+    for (int w = 0; w < m->E; w++) {
+        for (size_t x = 0; x < nl && lines[w] != ~0ULL; x++) {
+            if (info[x].line == lines[w]) {
+                lines[w] = ~0ULL;
+                inTile++;
+            }
+        }
+    }
+    after = valid - inTile + (int)nl < m->E ? valid - inTile + (int)nl : m->E;
+    if (nl > (size_t)m->E) {
+        for (size_t k = 0; k < (size_t)m->E; k++) {
+            size_t latest = k;
+            lineInfo tmp;
+            for (size_t x = k + 1; x < nl; x++) {
+                if (info[x].last > info[latest].last)
+                    latest = x;
+            }
+            tmp = info[k];
+            info[k] = info[latest];
+            info[latest] = tmp;
+        }
+        nl = (size_t)m->E;
+    }
+    for (size_t x = 0; x < nl; x++) {
+        int victim = 0;
+        for (int w = 0; w < m->E; w++) {
+            if (lines[w] == ~0ULL) {
+                victim = w;
+                break;
+            }
+            if (stamps[w] < stamps[victim])
+                victim = w;
+        }
+        lines[victim] = info[x].line;
+        stamps[victim] = m->tileBase + info[x].last;
+    }
+    m->fills += (unsigned int)(after - valid);
+    return misses;
+}
+
+/*
+ * tileKey - Everything the current tile's conflict misses and relative
+ *     footprint depend on
+ */
+static void tileKey(model *m, tileClass *k)
+{
+    unsigned long long a = m->baseA + ((unsigned long long)m->ti * (unsigned long long)m->M + (unsigned long long)m->tj) * sizeof(int);
+    unsigned long long b = m->baseB + ((unsigned long long)m->tj * (unsigned long long)m->N + (unsigned long long)m->ti) * sizeof(int);
+    unsigned long long mask = (1ULL << m->b) - 1;
+    int crosses = m->ti < m->jend && m->tj < m->iend;
+
+    k->rows = m->iend - m->ti;
+    k->cols = m->jend - m->tj;
+    k->mode = m->p->diag == DIAG_DEFER && !crosses ? DIAG_NONE : m->p->diag;
+    k->parity = m->p->order == TRAV_SNAKE ? 1 + (m->ti & 1) : 0;
+    m->mode = k->mode;
+    k->diag = k->mode == DIAG_DEFER ? m->ti - m->tj : 0;
+    k->phaseA = a & mask;
+    k->phaseB = b & mask;
+    k->sets = ((a >> m->b) - (b >> m->b)) & ((1ULL << m->s) - 1);
+    m->lineA = a >> m->b;
+    m->lineB = b >> m->b;
+}
+
+/*
+ * grow - Make room for n more items of size bytes in a pool. Returns -1
+ *     when memory runs out.
+ */
+static int grow(void **pool, size_t *cap, size_t used, size_t n, size_t size)
+{
+    size_t want = *cap ? *cap : 256;
+    void *grown;
+
+    while (want < used + n)
+        want *= 2;
+    if (want == *cap)
+        return 0;
+    grown = realloc(*pool, want * size);
+    if (!grown)
+        return -1;
+    *pool = grown;
+    *cap = want;
+    return 0;
+}
+
+/*
+ * findFootprint - Slot in fpIndex of the footprint of A (isB 0) or B of
+ *     the class k, or the empty slot it goes in
+ */
+static size_t findFootprint(const planModel *pm, const tileClass *k, int isB, unsigned long long *hash)
+{
+    unsigned long long phase = isB ? k->phaseB : k->phaseA;
+    unsigned long long h = (unsigned long long)k->rows * 37 + (unsigned long long)k->cols;
+    size_t slot;
+
+    h = h * 7 + (unsigned long long)(k->mode * 3 + k->parity);
+    h = h * 1000003ULL + (unsigned long long)(unsigned int)k->diag;
+    h = (h * 1000003ULL + phase) * 2 + (unsigned long long)isB;
+    h *= 0x9e3779b97f4a7c15ULL;
+    h ^= h >> 32;
+    *hash = h;
+    for (slot = (size_t)h & (pm->fpIndexCap - 1); pm->fpIndex[slot]; slot = (slot + 1) & (pm->fpIndexCap - 1)) {
+        const footprint *f = &pm->fps[pm->fpIndex[slot] - 1];
+        if (f->hash == h && f->rows == k->rows && f->cols == k->cols && f->mode == k->mode &&
+            f->parity == k->parity && f->diag == k->diag && f->isB == isB && f->phase == phase)
+            break;
+    }
+    return slot;
+}
+
+/*
+ * makeFootprint - Segments of A or B in the current tile, in the class's
+ *     frame, grouped by set with their lines and the misses among each
+ *     set's own lines
+ */
+static int makeFootprint(model *m, footprint *f)
+{
+    planModel *pm = m->pm;
+
+    m->segCount = 0;
+    m->usedCount = 0;
+    if (f->isB) {
+        for (int j = m->tj; j < m->jend; j++)
+            addSegments(m, m->frameB + (unsigned long long)(j - m->tj) * (unsigned long long)m->N * sizeof(int),
+                        1, j, m->ti, m->iend - 1);
+    } else {
+        for (int i = m->ti; i < m->iend; i++)
+            addSegments(m, m->frameA + (unsigned long long)(i - m->ti) * (unsigned long long)m->M * sizeof(int),
+                        0, i, m->tj, m->jend - 1);
+    }
+    if (grow((void **)&pm->fpGroups, &pm->fpGroupsCap, pm->fpGroupsUsed, m->usedCount, sizeof(fpGroup)) < 0 ||
+        grow((void **)&pm->fpSegs, &pm->fpSegsCap, pm->fpSegsUsed, m->segCount, sizeof(segment)) < 0 ||
+        grow((void **)&pm->fpLines, &pm->fpLinesCap, pm->fpLinesUsed, m->segCount, sizeof(lineInfo)) < 0)
+        return -1;
+
+    f->group = pm->fpGroupsUsed;
+    f->groups = m->usedCount;
+    f->conflicts = 0;
+    f->lines = 0;
+    for (size_t u = 0; u < m->usedCount; u++) {
+        unsigned int set = m->usedSets[u];
+        fpGroup *g = &pm->fpGroups[pm->fpGroupsUsed++];
+        segment *seg = &pm->fpSegs[pm->fpSegsUsed];
+        lineInfo *lines = &pm->fpLines[pm->fpLinesUsed];
+        size_t n = 0, earliest = 0;
+
+        for (int k = m->setHead[set]; k >= 0; k = m->segNext[k])
+            seg[n++] = m->seg[k];
+        m->setHead[set] = -1;
+        sortSegments(seg, n);
+        g->set = set;
+        g->seg = pm->fpSegsUsed;
+        g->segs = n;
+        g->lines = numberLines(m, seg, n, 0, 0);
+        g->conflicts = conflictMisses(m, seg, n, g->lines);
+        g->line = pm->fpLinesUsed;
+        g->latest = 0;
+        for (size_t x = 0; x < g->lines; x++) {
+            lines[x] = m->info[x];
+            if (lines[x].first < lines[earliest].first)
+                earliest = x;
+        }
+        lines[earliest] = lines[0];
+        lines[0] = m->info[earliest];
+        for (size_t x = 1; x < g->lines; x++) {
+            if (lines[x].last > lines[g->latest].last)
+                g->latest = x;
+        }
+        pm->fpSegsUsed += n;
+        pm->fpLinesUsed += g->lines;
+        f->conflicts += g->conflicts;
+        f->lines += (unsigned int)g->lines;
+    }
+    return 0;
+}
+
+/*
+ * footprintOf - Index in fps of the footprint of A or B in the current
+ *     tile, made on first use. Returns -1 when memory runs out.
+ */
+static long footprintOf(model *m, const tileClass *k, int isB)
+{
+    planModel *pm = m->pm;
+    unsigned long long h;
+    size_t slot;
+
+    if ((pm->fpUsed + 1) * 2 > pm->fpIndexCap) {
+        size_t cap = pm->fpIndexCap ? pm->fpIndexCap * 2 : 256;
+        size_t *index = calloc(cap, sizeof(size_t));
+        if (!index)
+            return -1;
+        for (size_t x = 0; x < pm->fpUsed; x++) {
+            size_t to = (size_t)pm->fps[x].hash & (cap - 1);
+            while (index[to])
+                to = (to + 1) & (cap - 1);
+            index[to] = x + 1;
+        }
+        free(pm->fpIndex);
+        pm->fpIndex = index;
+        pm->fpIndexCap = cap;
+    }
+    slot = findFootprint(pm, k, isB, &h);
+    if (!pm->fpIndex[slot]) {
+        footprint f = {k->rows, k->cols, k->mode, k->parity, k->diag, isB,
+                       isB ? k->phaseB : k->phaseA, 0, 0, 0, 0, h};
+        if (grow((void **)&pm->fps, &pm->fpCap, pm->fpUsed, 1, sizeof(footprint)) < 0 ||
+            makeFootprint(m, &f) < 0)
+            return -1;
+        pm->fps[pm->fpUsed++] = f;
+        pm->fpIndex[slot] = pm->fpUsed;
+    }
+    return (long)(pm->fpIndex[slot] - 1);
+}
+
+/*
+ * setLines - The lines of one set of the current tile: the segments of an
+ *     A group, a B group, or both, copied to m->group and numbered with
+ *     A's lines first. Returns the number of lines.
+ */
+static size_t setLines(model *m, const fpGroup *ga, const fpGroup *gb, size_t *n)
+{
+    const segment *fpSegs = m->pm->fpSegs;
+
+    *n = 0;
+    if (ga) {
+        for (size_t k = 0; k < ga->segs; k++)
+            m->group[(*n)++] = fpSegs[ga->seg + k];
+    }
+    if (gb) {
+        for (size_t k = 0; k < gb->segs; k++)
+            m->group[(*n)++] = fpSegs[gb->seg + k];
+    }
+    return numberLines(m, m->group, *n, m->lineA, m->lineB);
+}
+
+/*
+ * findPair - Slot of the pair of groups ga and gb, or the empty slot it goes in
+ */
+static size_t findPair(const planModel *pm, size_t ga, size_t gb)
+{
+    unsigned long long h = ((unsigned long long)ga * 1000003ULL + gb) * 0x9e3779b97f4a7c15ULL;
+    size_t slot = (size_t)(h ^ (h >> 32)) & (pm->pairCap - 1);
+
+    while (pm->pairs[slot].ga && (pm->pairs[slot].ga != ga + 1 || pm->pairs[slot].gb != gb + 1))
+        slot = (slot + 1) & (pm->pairCap - 1);
+    return slot;
+}
+
+/*
+ * growPairs - Double the pair table once it is half full. Returns -1 when
+ *     memory runs out.
+ */
+static int growPairs(planModel *pm)
+{
+    setPair *old = pm->pairs;
+    size_t oldCap = pm->pairCap;
+    setPair *grown = calloc(oldCap * 2, sizeof(setPair));
+
+    if (!grown)
+        return -1;
+    pm->pairs = grown;
+    pm->pairCap = oldCap * 2;
+    for (size_t k = 0; k < oldCap; k++)
+        if (old[k].ga)
+            pm->pairs[findPair(pm, old[k].ga - 1, old[k].gb - 1)] = old[k];
+    free(old);
+    return 0;
+}
+
+/*
+ * pairConflicts - Conflict misses the A group ga and the B group gb add to
+ *     their own when they share a set, counted on first use. Returns -1
+ *     when memory runs out.
+ */
+static int pairConflicts(model *m, const fpGroup *ga, const fpGroup *gb, unsigned int *conflicts)
+{
+    planModel *pm = m->pm;
+    size_t a = (size_t)(ga - pm->fpGroups), b = (size_t)(gb - pm->fpGroups);
+    size_t slot = findPair(pm, a, b);
+    size_t n, nl;
+
+    if (!pm->pairs[slot].ga) {
+        if ((pm->pairUsed + 1) * 2 > pm->pairCap) {
+            if (growPairs(pm) < 0)
+                return -1;
+            slot = findPair(pm, a, b);
+        }
+        nl = setLines(m, ga, gb, &n);
+        pm->pairs[slot].ga = a + 1;
+        pm->pairs[slot].gb = b + 1;
+        pm->pairs[slot].conflicts = conflictMisses(m, m->group, n, nl) - ga->conflicts - gb->conflicts;
+        pm->pairUsed++;
+    }
+    *conflicts += pm->pairs[slot].conflicts;
+    return 0;
+}
+
+/*
+ * replaySet - First touches of one set of the current tile, whose lines are
+ *     those of an A group, a B group, or both
+ */
+static unsigned int replaySet(model *m, unsigned int set, const fpGroup *ga, const fpGroup *gb)
+{
+    const lineInfo *fpLines = m->pm->fpLines;
+    size_t nl = 0;
+
+    if (m->E == 1) {
+        // the earliest and latest of both sets' lines are all that matter
+        const lineInfo *ea = ga ? &fpLines[ga->line] : NULL, *la = ga ? &fpLines[ga->line + ga->latest] : NULL;
+        const lineInfo *eb = gb ? &fpLines[gb->line] : NULL, *lb = gb ? &fpLines[gb->line + gb->latest] : NULL;
+        unsigned long long earliest, latest, last;
+        if (!eb || (ea && ea->first < eb->first))
+            earliest = m->lineA + ea->line;
+        else
+            earliest = m->lineB + eb->line;
+        if (!lb || (la && la->last > lb->last)) {
+            latest = m->lineA + la->line;
+            last = la->last;
+        } else {
+            latest = m->lineB + lb->line;
+            last = lb->last;
+        }
+        return directFirstTouches(m, set, earliest, latest, last,
+                                  (ga ? ga->lines : 0) + (gb ? gb->lines : 0));
+    }
+
+    for (int isB = 0; isB < 2; isB++) {
+        const fpGroup *g = isB ? gb : ga;
+        for (size_t x = 0; g && x < g->lines; x++) {
+            m->info[nl] = fpLines[g->line + x];
+            m->info[nl++].line += isB ? m->lineB : m->lineA;
+        }
+    }
+    return firstTouches(m, set, m->info, nl);
+}
+
+/*
+ * mergeSets - Walk the sets of the current tile, made of the footprints fa
+ *     and fb with A's sets key->sets after B's, adding to *conflicts what
+ *     the sets both use add to the footprints' own conflict misses. When
+ *     lines are shared, also replays every set's first touches. Returns -1
+ *     when memory runs out.
+ */
+static int mergeSets(model *m, const tileClass *key, const footprint *fa, const footprint *fb,
+                     unsigned int *conflicts)
+{
+    planModel *pm = m->pm;
+    const fpGroup *groupsA = &pm->fpGroups[fa->group], *groupsB = &pm->fpGroups[fb->group];
+    unsigned long long mask = (1ULL << m->s) - 1;
+    int status = 0;
+
+    for (size_t g = 0; g < fb->groups; g++)
+        pm->slot[groupsB[g].set] = (int)g;
+    for (size_t g = 0; g < fa->groups; g++) {
+        const fpGroup *ga = &groupsA[g];
+        int *other = &pm->slot[(ga->set + key->sets) & mask];
+        const fpGroup *gb = *other >= 0 ? &groupsB[*other] : NULL;
+        if (gb && pairConflicts(m, ga, gb, conflicts) < 0)
+            status = -1;
+        if (m->shared)
+            m->res->misses += replaySet(m, (unsigned int)((m->lineA + ga->set) & mask), ga, gb);
+        // B's group is done with
+        if (gb)
+            *other = -2;
+    }
+    for (size_t g = 0; g < fb->groups; g++) {
+        const fpGroup *gb = &groupsB[g];
+        if (m->shared && pm->slot[gb->set] != -2)
+            m->res->misses += replaySet(m, (unsigned int)((m->lineB + gb->set) & mask), NULL, gb);
+        pm->slot[gb->set] = -1;
+    }
+    return status;
+}
+
+/*
+ * modelTile - Misses of the current tile. Its footprints of A and B are
+ *     made on first use in the class's frame, where they carry the
+ *     conflict misses among the lines of each set; sets that both use add
+ *     the misses of their pair of groups, also counted once. Without lines
+ *     shared between tiles every first touch misses; with them, the first
+ *     touches are replayed against the LRU state from the footprints'
+ *     lines. Returns -1 when memory runs out.
+ */
+static int modelTile(model *m)
+{
+    planModel *pm = m->pm;
+    tileClass key;
+    long fa, fb;
+    unsigned int conflicts, lines;
+
+    tileKey(m, &key);
+    // the class's frame: the tile moved to rows 0 or 1, keeping the parity
+    // of its rows and, when it matters, its offset from the diagonal, with
+    // the first int of A and of B at their phase within a line
+    m->ti = key.parity ? m->ti & 1 : 0;
+    m->tj = key.mode == DIAG_DEFER ? m->ti - key.diag : 0;
+    m->iend = m->ti + key.rows;
+    m->jend = m->tj + key.cols;
+    m->frameA = key.phaseA - (unsigned long long)m->tj * sizeof(int);
+    m->frameB = key.phaseB - (unsigned long long)m->ti * sizeof(int);
+    fa = footprintOf(m, &key, 0);
+    fb = fa >= 0 ? footprintOf(m, &key, 1) : -1;
+    if (fb < 0)
+        return -1;
+    conflicts = pm->fps[fa].conflicts + pm->fps[fb].conflicts;
+    lines = pm->fps[fa].lines + pm->fps[fb].lines;
+    if (mergeSets(m, &key, &pm->fps[fa], &pm->fps[fb], &conflicts) < 0)
+        return -1;
+    m->res->misses += conflicts + (m->shared ? 0 : lines);
+    m->touched += lines;
+    return 0;
+}
+
+/*
+ * lineCount - Lines of first..last that map to set
+ */
+static unsigned long long lineCount(unsigned long long first, unsigned long long last,
+                                    unsigned long long sets, unsigned long long set)
+{
+    unsigned long long lo = first + ((set - first % sets) + sets) % sets;
+    return lo > last ? 0 : (last - lo) / sets + 1;
+}
+
+/*
+ * coldFills - Misses that fill an empty line rather than evict: per set, the
+ *     lines of A and B that map to it, up to E. The counts only change at
+ *     the sets where A or B start or end, so each stretch between those is
+ *     summed at once.
+ */
+static unsigned long long coldFills(const model *m)
+{
+    unsigned long long sets = 1ULL << m->s;
+    unsigned long long a0 = m->baseA >> m->b;
+    unsigned long long a1 = (m->baseA + (unsigned long long)m->M * (unsigned long long)m->N * sizeof(int) - 1) >> m->b;
+    unsigned long long b0 = m->baseB >> m->b;
+    unsigned long long b1 = (m->baseB + (unsigned long long)m->M * (unsigned long long)m->N * sizeof(int) - 1) >> m->b;
+    unsigned long long cut[5] = {0, a0 % sets, (a1 + 1) % sets, b0 % sets, (b1 + 1) % sets};
+    unsigned long long fills = 0;
+
+    for (int k = 1; k < 5; k++) {
+        unsigned long long tmp = cut[k];
+        int x = k;
+        for (; x > 0 && cut[x - 1] > tmp; x--)
+            cut[x] = cut[x - 1];
+        cut[x] = tmp;
+    }
+    for (int k = 0; k < 5; k++) {
+        unsigned long long end = k < 4 ? cut[k + 1] : sets;
+        unsigned long long count;
+        if (end == cut[k])
+            continue;
+        count = lineCount(a0, a1, sets, cut[k]) + lineCount(b0, b1, sets, cut[k]);
+        fills += (end - cut[k]) * (count < (unsigned long long)m->E ? count : (unsigned long long)m->E);
+    }
+    return fills;
+}
+
+/*
+ * growScratch - Make room for the segments of one tile of p
+ */
+static int growScratch(planModel *pm, const trans_plan *p)
+{
+    // a row of ints never covers more lines than ints, plus the partial lines at both ends
+    size_t need = (size_t)p->tile_rows * (size_t)(p->tile_cols + 2) +
+                  (size_t)p->tile_cols * (size_t)(p->tile_rows + 2);
+    void *seg, *segNext, *usedSets, *group, *info, *marks, *bounds;
+
+    if (need <= pm->maxSeg)
+        return 0;
+    seg = realloc(pm->seg, need * sizeof(segment));
+    if (seg)
+        pm->seg = seg;
+    segNext = realloc(pm->segNext, need * sizeof(int));
+    if (segNext)
+        pm->segNext = segNext;
+    usedSets = realloc(pm->usedSets, need * sizeof(unsigned int));
+    if (usedSets)
+        pm->usedSets = usedSets;
+    group = realloc(pm->group, need * sizeof(segment));
+    if (group)
+        pm->group = group;
+    info = realloc(pm->info, need * sizeof(lineInfo));
+    if (info)
+        pm->info = info;
+    // every other segment marks at most 16 window ranges of a B segment
+    marks = realloc(pm->marks, 16 * need * sizeof(mark));
+    if (marks)
+        pm->marks = marks;
+    bounds = realloc(pm->bounds, 32 * need * sizeof(int));
+    if (bounds)
+        pm->bounds = bounds;
+    if (!seg || !segNext || !usedSets || !group || !info || !marks || !bounds)
+        return -1;
+    pm->maxSeg = need;
+    return 0;
+}
+
+planModel *createPlanModel(int M, int N, unsigned long long baseA, unsigned long long baseB,
+                           int s, int E, int b)
+{
+    planModel *pm;
+    size_t sets = (size_t)1 << s;
+    unsigned long long bytes = (unsigned long long)M * (unsigned long long)N * sizeof(int);
+
+    if (M < 1 || N < 1 || s < 0 || E < 1 || b < 0)
+        return NULL;
+    // tiles are made of separate footprints of A and B
+    if ((baseA + bytes - 1) >> b >= baseB >> b && (baseB + bytes - 1) >> b >= baseA >> b)
+        return NULL;
+    pm = calloc(1, sizeof(planModel));
+    if (!pm)
+        return NULL;
+    pm->M = M;
+    pm->N = N;
+    pm->baseA = baseA;
+    pm->baseB = baseB;
+    pm->s = s;
+    pm->E = E;
+    pm->b = b;
+    pm->pairCap = 1024;
+    pm->lines = malloc(sets * (size_t)E * sizeof(unsigned long long));
+    pm->stamps = malloc(sets * (size_t)E * sizeof(unsigned long long));
+    pm->setHead = malloc(sets * sizeof(int));
+    pm->setTail = malloc(sets * sizeof(int));
+    pm->slot = malloc(sets * sizeof(int));
+    pm->pairs = calloc(pm->pairCap, sizeof(setPair));
+    if (!pm->lines || !pm->stamps || !pm->setHead || !pm->setTail || !pm->slot || !pm->pairs) {
+        freePlanModel(pm);
+        return NULL;
+    }
+    for (size_t k = 0; k < sets; k++) {
+        pm->setHead[k] = -1;
+        pm->slot[k] = -1;
+    }
+    return pm;
+}
+
+void freePlanModel(planModel *pm)
+{
+    if (!pm)
+        return;
+    free(pm->lines);
+    free(pm->stamps);
+    free(pm->setHead);
+    free(pm->setTail);
+    free(pm->seg);
+    free(pm->segNext);
+    free(pm->usedSets);
+    free(pm->group);
+    free(pm->info);
+    free(pm->marks);
+    free(pm->bounds);
+    free(pm->fps);
+    free(pm->fpIndex);
+    free(pm->fpLines);
+    free(pm->pairs);
+    free(pm->fpGroups);
+    free(pm->fpSegs);
+    free(pm->slot);
+    free(pm);
+}
+
+int predictPlan(planModel *pm, const trans_plan *p, unsigned int limit, planModelResult *out)
+{
+    model m;
+    unsigned long long line = 1ULL << pm->b;
+    unsigned long long elems = (unsigned long long)pm->M * (unsigned long long)pm->N;
+    unsigned long long endA = pm->baseA + elems * sizeof(int) - 1, endB = pm->baseB + elems * sizeof(int) - 1;
+    unsigned long long linesA = (endA >> pm->b) - (pm->baseA >> pm->b) + 1;
+    unsigned long long linesB = (endB >> pm->b) - (pm->baseB >> pm->b) + 1;
+    unsigned long long total;
+
+    if (p->tile_rows < 1 || p->tile_cols < 1 || p->tile_cols > PLAN_MAX_TILE ||
+        p->order < 0 || p->order >= TRAV_COUNT || p->diag < 0 || p->diag >= DIAG_COUNT ||
+        growScratch(pm, p) < 0)
+        return -1;
+
+    m.pm = pm;
+    m.p = p;
+    m.M = pm->M;
+    m.N = pm->N;
+    m.baseA = pm->baseA;
+    m.baseB = pm->baseB;
+    m.s = pm->s;
+    m.E = pm->E;
+    m.b = pm->b;
+    m.tileBase = 1;
+    m.lines = pm->lines;
+    m.stamps = pm->stamps;
+    m.seg = pm->seg;
+    m.setHead = pm->setHead;
+    m.setTail = pm->setTail;
+    m.segNext = pm->segNext;
+    m.usedSets = pm->usedSets;
+    m.group = pm->group;
+    m.info = pm->info;
+    m.marks = pm->marks;
+    m.bounds = pm->bounds;
+    m.fills = 0;
+    m.touched = 0;
+    m.res = out;
+    out->hits = out->misses = out->evictions = 0;
+
+    // lines that straddle two tiles need the LRU state; so do lines
+    // shorter than an int, where coldFills would count lines that are
+    // never touched
+    m.shared = line < sizeof(int) || pm->baseA % line || pm->baseB % line ||
+               ((unsigned long long)pm->M * sizeof(int)) % line ||
+               ((unsigned long long)pm->N * sizeof(int)) % line ||
+               ((unsigned long long)p->tile_cols * sizeof(int)) % line ||
+               ((unsigned long long)p->tile_rows * sizeof(int)) % line;
+    // every line misses at least once, so a plan is beaten as soon as its
+    // misses and the lines it has yet to touch pass limit
+    total = linesA + linesB;
+    if (m.shared) {
+        size_t ways = ((size_t)1 << pm->s) * (size_t)pm->E;
+        for (size_t k = 0; k < ways; k++) {
+            m.lines[k] = ~0ULL;
+            m.stamps[k] = 0;
+        }
+    }
+
+    // same tile order as PLAN_TRANSPOSE_BODY
+    int rows = (m.N + p->tile_rows - 1) / p->tile_rows;
+    int cols = (m.M + p->tile_cols - 1) / p->tile_cols;
+    int outer = p->order == TRAV_COL ? cols : rows, inner = p->order == TRAV_COL ? rows : cols;
+    for (int pass = 0; pass < (p->order == TRAV_DIAG ? 2 : 1); pass++) {
+        for (int x = 0; x < outer; x++) {
+            for (int y = 0; y < inner; y++) {
+                m.ti = (p->order == TRAV_COL ? y : x) * p->tile_rows;
+                m.tj = (p->order == TRAV_COL ? x : y) * p->tile_cols;
+                m.iend = m.ti + p->tile_rows < m.N ? m.ti + p->tile_rows : m.N;
+                m.jend = m.tj + p->tile_cols < m.M ? m.tj + p->tile_cols : m.M;
+                if (p->order == TRAV_DIAG) {
+                    int ondiag = m.ti < m.jend && m.tj < m.iend;
+                    if (ondiag != pass)
+                        continue;
+                }
+                // rows only need room for their own writes, so tiles of the
+                // same size share their times whatever the plan's tile_cols
+                m.rowSpan = 2 * (unsigned long long)(m.jend - m.tj) + 1;
+                if (modelTile(&m) < 0)
+                    return -1;
+                m.tileBase += (unsigned long long)p->tile_rows * (2 * (unsigned long long)p->tile_cols + 1);
+                if (out->misses + (total > m.touched ? total - m.touched : 0) > limit)
+                    return 1;
+            }
+        }
+    }
+
+    // every access is a hit or a miss, and every miss without an empty line evicts
+    out->hits = (unsigned int)(2 * elems) - out->misses;
+    out->evictions = out->misses - (m.shared ? m.fills : (unsigned int)coldFills(&m));
+    return 0;
+}
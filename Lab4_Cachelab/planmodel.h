@@ -0,0 +1,56 @@
+/*
+ * planmodel.h - Analytical miss model for plan driven tiled transposes
+ *
+ * Predicts the hits, misses and evictions of PLAN_TRANSPOSE_BODY on an LRU
+ * cache without replaying its accesses. Each tile is reduced to the cache
+ * lines of A and B it touches and the rows each line is touched on, and
+ * the misses of every set are counted in closed form from that footprint
+ * (see planmodel.c): first touches against the LRU state left by earlier
+ * tiles, runs of A reads broken by writes to B on a direct-mapped cache,
+ * and touches of a B line reached after E or more other lines of its set.
+ *
+ * Tiles with the same footprint up to whole cache sizes share their counts,
+ * so a model answers for a few distinct tiles per plan, and the tiles it
+ * has seen carry over to the next plan asked of the same model.
+ *
+ * The result is exact, and agrees with the cache model (and so with csim),
+ * when every row of A and B spans at least two cache lines; narrower rows
+ * let the touches of one B line interleave within a tile, which the model
+ * does not track, and may be off by a few misses. A miss limit lets a
+ * tuner abandon a candidate as soon as it is beaten.
+ */
+#ifndef PLANMODEL_H
+#define PLANMODEL_H
+
+#include "trans_plan.h"
+
+typedef struct {
+    unsigned int hits;
+    unsigned int misses;
+    unsigned int evictions;
+} planModelResult;
+
+/* No miss limit */
+#define PLAN_NO_LIMIT (~0U)
+
+typedef struct planModel planModel;
+
+/*
+ * createPlanModel - Model of transposing the N x M int matrix at baseA into
+ *     baseB on a cold cache of 2^s sets of E lines of 2^b bytes. Returns
+ *     NULL if the geometry is invalid, A and B share a cache line, or
+ *     memory runs out.
+ */
+planModel *createPlanModel(int M, int N, unsigned long long baseA, unsigned long long baseB,
+                           int s, int E, int b);
+
+/*
+ * predictPlan - Predict plan p. Returns 0, 1 if the prediction stopped
+ *     early because the misses were sure to pass limit (out then holds the
+ *     counts so far), or -1 if the plan is invalid or memory runs out.
+ */
+int predictPlan(planModel *pm, const trans_plan *p, unsigned int limit, planModelResult *out);
+
+void freePlanModel(planModel *pm);
+
+#endif /* PLANMODEL_H */
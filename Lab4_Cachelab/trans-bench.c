@@ -0,0 +1,240 @@
+/*
+ * trans-bench.c - Native wall-clock benchmark for the transpose functions
+ *
+ * test-trans scores transposes by simulated misses only. This driver runs
+ * every function registered in registerFunctions() natively over a sweep
+ * of matrix shapes, with warm-up runs and timed repetitions, and reports
+ * the median latency and the throughput (bytes read plus bytes written per
+ * second). When the kernel allows it, the hardware cache miss and dTLB miss
+ * counters are read through perf_event_open and averaged per run; when it
+ * does not (perf_event_paranoid, containers, VMs) those columns show n/a.
+ *
+ * Build:   gcc -O2 -pthread -o trans-bench trans-bench.c trans.c cachelab.c
+ * Example: ./trans-bench -r 20 256x256 1024x1024 4096x4096
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "cachelab.h"
+
+#define MAX_SHAPES 64
+#define MAX_REPS 1000
+
+extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern int func_counter;
+extern void registerFunctions(void);
+extern int is_transpose(int M, int N, int A[N][M], int B[M][N]);
+
+static const int default_shapes[][2] = {
+    {32, 32}, {64, 64}, {61, 67}, {256, 256}, {1024, 1024}, {4096, 4096}
+};
+
+/* Hardware counters, -1 when unavailable */
+static int fd_cache = -1;
+static int fd_tlb = -1;
+
+/*
+ * open_counter - Open one user-space counting event for this process
+ */
+static int open_counter(unsigned int type, unsigned long long config)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static void open_counters(void)
+{
+    fd_cache = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    if (fd_cache < 0) {
+        printf("perf counters unavailable (%s), miss columns show n/a\n", strerror(errno));
+        return;
+    }
+    fd_tlb = open_counter(PERF_TYPE_HW_CACHE,
+                          PERF_COUNT_HW_CACHE_DTLB |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+}
+
+static void start_counter(int fd)
+{
+    if (fd >= 0) {
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static long long stop_counter(int fd)
+{
+    long long count = 0;
+
+    if (fd < 0)
+        return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != (ssize_t)sizeof(count))
+        return -1;
+    return count;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void print_count(long long total, int reps)
+{
+    if (total < 0)
+        printf(" %12s", "n/a");
+    else
+        printf(" %12lld", total / reps);
+}
+
+/*
+ * bench_shape - Time every registered function on an N x M matrix
+ */
+static void bench_shape(int M, int N, int warmup, int reps)
+{
+    size_t elems = (size_t)M * (size_t)N;
+    int *A = malloc(elems * sizeof(int));
+    int *B = malloc(elems * sizeof(int));
+    double times[MAX_REPS];
+
+    if (!A || !B) {
+        printf("%dx%d: out of memory\n", M, N);
+        free(A);
+        free(B);
+        return;
+    }
+    for (size_t k = 0; k < elems; k++)
+        A[k] = (int)k;
+
+    for (int f = 0; f < func_counter; f++) {
+        void (*fn)(int, int, int[N][M], int[M][N]) = func_list[f].func_ptr;
+        long long cache_total = 0, tlb_total = 0;
+
+        memset(B, 0, elems * sizeof(int));
+        fn(M, N, (int (*)[M])A, (int (*)[N])B);
+        int correct = is_transpose(M, N, (int (*)[M])A, (int (*)[N])B);
+        for (int w = 1; w < warmup; w++)
+            fn(M, N, (int (*)[M])A, (int (*)[N])B);
+
+        for (int r = 0; r < reps; r++) {
+            start_counter(fd_cache);
+            start_counter(fd_tlb);
+            double t = now();
+            fn(M, N, (int (*)[M])A, (int (*)[N])B);
+            times[r] = now() - t;
+            long long c = stop_counter(fd_cache);
+            long long l = stop_counter(fd_tlb);
+            cache_total = c < 0 || cache_total < 0 ? -1 : cache_total + c;
+            tlb_total = l < 0 || tlb_total < 0 ? -1 : tlb_total + l;
+        }
+        qsort(times, (size_t)reps, sizeof(double), cmp_double);
+        double median = reps % 2 ? times[reps / 2] : (times[reps / 2 - 1] + times[reps / 2]) / 2;
+        double gbs = median > 0 ? 2.0 * (double)(elems * sizeof(int)) / median / 1e9 : 0;
+
+        printf("%5dx%-5d %-42.42s %12.3f %9.2f", M, N, func_list[f].description,
+               median * 1e6, gbs);
+        print_count(cache_total, reps);
+        print_count(tlb_total, reps);
+        printf("%s\n", correct ? "" : "  INCORRECT");
+    }
+    free(A);
+    free(B);
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] [-w <num>] [-r <num>] [<M>x<N>...]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -w <num>    Warm-up runs per function and shape (default 2).\n");
+    printf("  -r <num>    Timed repetitions per function and shape (default 10).\n");
+    printf("Without shapes, sweeps 32x32 64x64 61x67 256x256 1024x1024 4096x4096.\n");
+    printf("Example: %s -r 20 1024x1024 4096x4096\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int warmup = 2, reps = 10;
+    int opt;
+    int shapes[MAX_SHAPES][2];
+    int num_shapes = 0;
+
+    while ((opt = getopt(argc, argv, "w:r:h")) != -1) {
+        switch (opt) {
+        case 'w':
+            warmup = atoi(optarg);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv);
+            return 0;
+        default:
+            usage(argv);
+            return 1;
+        }
+    }
+    if (warmup < 1)
+        warmup = 1;
+    if (reps < 1 || reps > MAX_REPS) {
+        printf("Error: repetitions must be between 1 and %d\n", MAX_REPS);
+        return 1;
+    }
+
+    for (int i = optind; i < argc && num_shapes < MAX_SHAPES; i++) {
+        if (sscanf(argv[i], "%dx%d", &shapes[num_shapes][0], &shapes[num_shapes][1]) != 2 ||
+            shapes[num_shapes][0] <= 0 || shapes[num_shapes][1] <= 0) {
+            printf("Error: malformed shape %s\n", argv[i]);
+            return 1;
+        }
+        num_shapes++;
+    }
+    if (num_shapes == 0) {
+        num_shapes = (int)(sizeof(default_shapes) / sizeof(default_shapes[0]));
+        memcpy(shapes, default_shapes, sizeof(default_shapes));
+    }
+
+    registerFunctions();
+    open_counters();
+
+    printf("%-11s %-42s %12s %9s %12s %12s\n", "shape", "function", "median(us)",
+           "GB/s", "cache-miss", "dTLB-miss");
+    for (int i = 0; i < num_shapes; i++)
+        bench_shape(shapes[i][0], shapes[i][1], warmup, reps);
+
+    if (fd_cache >= 0)
+        close(fd_cache);
+    if (fd_tlb >= 0)
+        close(fd_tlb);
+    return 0;
+}
@@ -0,0 +1,288 @@
+/*
+ * trans-check.c - Correctness check for the entry points in trans_ops.h
+ *
+ * test-trans and trans-rec only run the registered int[N][M] functions,
+ * so the in-place, batched, element-width and tensor transposes are never
+ * checked by the driver. This program runs each of them over a list of
+ * cases chosen to reach every path they take (SIMD tiles and ragged edges,
+ * odd and one-wide shapes, a batch of one, 16-byte elements, size-1 and
+ * fused tensor axes, rejected arguments) and compares the output with a
+ * naive element-by-element reference. Batched matrices sit in padded slots
+ * and the padding is checked too, so writes past a matrix are caught.
+ *
+ * Build:   gcc -O2 -pthread -o trans-check trans-check.c trans.c cachelab.c
+ * Example: ./trans-check -v
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "cachelab.h"
+#include "trans_ops.h"
+
+/* Written around each batched matrix, must survive the call */
+#define GUARD 0x5a5a5a5a
+
+/* Padding between batched matrices, in ints */
+#define BATCH_PAD 5
+
+static int verbose = 0;
+static int failures = 0;
+static int cases = 0;
+
+static unsigned int seed = 1;
+
+/*
+ * fill - Fill n bytes with a fixed pseudo-random sequence
+ */
+static void fill(void *p, size_t n)
+{
+    unsigned char *c = p;
+
+    for (size_t k = 0; k < n; k++) {
+        seed = seed * 1103515245u + 12345u;
+        c[k] = (unsigned char)(seed >> 16);
+    }
+}
+
+/*
+ * report - Count one case and print it if it failed (or with -v)
+ */
+static void report(const char *what, const char *shape, long bad)
+{
+    cases++;
+    if (bad)
+        failures++;
+    if (bad || verbose)
+        printf("%-10s %-24s %s", what, shape, bad ? "FAIL" : "ok");
+    if (bad > 0)
+        printf(" (%ld wrong)", bad);
+    if (bad || verbose)
+        printf("\n");
+}
+
+/*
+ * check_inplace - inplace_transpose against a copy transposed naively
+ */
+static void check_inplace(int M, int N)
+{
+    size_t n = (size_t)M * N;
+    int *data = malloc(n * sizeof(int));
+    int *ref = malloc(n * sizeof(int));
+    char shape[32];
+    long bad = 0;
+
+    fill(data, n * sizeof(int));
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < M; j++) {
+            ref[(long)j * N + i] = data[(long)i * M + j];
+        }
+    }
+    if (inplace_transpose(M, N, data) != 0)
+        bad = -1;
+    for (size_t k = 0; bad >= 0 && k < n; k++) {
+        if (data[k] != ref[k])
+            bad++;
+    }
+    snprintf(shape, sizeof(shape), "%dx%d", M, N);
+    report("inplace", shape, bad);
+    free(data);
+    free(ref);
+}
+
+/*
+ * check_batch - batch_transpose of count matrices in padded slots
+ */
+static void check_batch(int M, int N, int count)
+{
+    long size = (long)M * N;
+    long a_stride = size + BATCH_PAD, b_stride = size + BATCH_PAD + 3;
+    int *A = malloc((size_t)(a_stride * count) * sizeof(int));
+    int *B = malloc((size_t)(b_stride * count) * sizeof(int));
+    char shape[32];
+    long bad = 0;
+
+    fill(A, (size_t)(a_stride * count) * sizeof(int));
+    for (long x = 0; x < b_stride * count; x++)
+        B[x] = GUARD;
+    batch_transpose(M, N, count, A, a_stride, B, b_stride);
+    for (int k = 0; k < count; k++) {
+        const int *a = A + k * a_stride;
+        const int *b = B + k * b_stride;
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < M; j++) {
+                if (b[(long)j * N + i] != a[(long)i * M + j])
+                    bad++;
+            }
+        }
+        for (long x = size; x < b_stride; x++) {
+            if (b[x] != GUARD)
+                bad++;
+        }
+    }
+    snprintf(shape, sizeof(shape), "%dx%d x%d", M, N, count);
+    report("batch", shape, bad);
+    free(A);
+    free(B);
+}
+
+/*
+ * check_width - transpose_width with width-byte elements
+ */
+static void check_width(int M, int N, int width)
+{
+    size_t n = (size_t)M * N * (size_t)width;
+    unsigned char *A = malloc(n);
+    unsigned char *B = malloc(n);
+    char shape[32];
+    long bad = 0;
+
+    fill(A, n);
+    memset(B, 0, n);
+    if (transpose_width(M, N, width, A, B) != 0)
+        bad = -1;
+    for (int i = 0; bad >= 0 && i < N; i++) {
+        for (int j = 0; j < M; j++) {
+            if (memcmp(B + ((size_t)j * N + i) * width, A + ((size_t)i * M + j) * width, (size_t)width))
+                bad++;
+        }
+    }
+    snprintf(shape, sizeof(shape), "%dx%d, %d bytes", M, N, width);
+    report("width", shape, bad);
+    free(A);
+    free(B);
+}
+
+/*
+ * check_permute - permute_tensor against the index arithmetic spelled out:
+ *     every dst element is looked up in src by its coordinates
+ */
+static void check_permute(int ndim, const int *dims, const int *perm)
+{
+    long total = 1, sstr[8], dims_dst[8];
+    char shape[64];
+    int len = 0;
+    long bad = 0;
+
+    for (int k = 0; k < ndim; k++)
+        total *= dims[k];
+    sstr[ndim - 1] = 1;
+    for (int k = ndim - 2; k >= 0; k--)
+        sstr[k] = sstr[k + 1] * dims[k + 1];
+    for (int k = 0; k < ndim; k++)
+        dims_dst[k] = dims[perm[k]];
+
+    int *src = malloc((size_t)total * sizeof(int));
+    int *dst = malloc((size_t)total * sizeof(int));
+    fill(src, (size_t)total * sizeof(int));
+    if (permute_tensor(ndim, dims, perm, src, dst) != 0)
+        bad = -1;
+    for (long x = 0; bad >= 0 && x < total; x++) {
+        long rest = x, s = 0;
+        for (int k = ndim - 1; k >= 0; k--) {
+            s += (rest % dims_dst[k]) * sstr[perm[k]];
+            rest /= dims_dst[k];
+        }
+        if (dst[x] != src[s])
+            bad++;
+    }
+
+    for (int k = 0; k < ndim; k++)
+        len += snprintf(shape + len, sizeof(shape) - len, "%s%d", k ? "x" : "", dims[k]);
+    len += snprintf(shape + len, sizeof(shape) - len, " (");
+    for (int k = 0; k < ndim; k++)
+        len += snprintf(shape + len, sizeof(shape) - len, "%s%d", k ? "," : "", perm[k]);
+    snprintf(shape + len, sizeof(shape) - len, ")");
+    report("permute", shape, bad);
+    free(src);
+    free(dst);
+}
+
+/*
+ * check_rejects - Arguments the entry points must refuse
+ */
+static void check_rejects(void)
+{
+    int dims[2] = {3, 3}, twice[2] = {0, 0}, zero[2] = {3, 0}, ident[2] = {0, 1};
+    int in[9] = {0}, out[9];
+    char buf[16];
+
+    report("reject", "width 3", transpose_width(3, 1, 3, buf, buf + 8) != -1);
+    report("reject", "perm (0,0)", permute_tensor(2, dims, twice, in, out) != -1);
+    report("reject", "dims 3x0", permute_tensor(2, zero, ident, in, out) != -1);
+    report("reject", "ndim 0", permute_tensor(0, dims, ident, in, out) != -1);
+    report("reject", "ndim 9", permute_tensor(9, dims, ident, in, out) != -1);
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-hv]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h  Print this help message.\n");
+    printf("  -v  Print every case, not just the failures.\n");
+}
+
+int main(int argc, char *argv[])
+{
+    /* odd, one-wide, square, tall and tile-multiple shapes */
+    static const int shapes[][2] = {
+        {1, 1}, {1, 7}, {7, 1}, {3, 5}, {5, 3}, {8, 8}, {6, 10}, {32, 32},
+        {32, 64}, {64, 32}, {48, 80}, {61, 67}, {64, 64}, {17, 33}
+    };
+    static const int batch_shapes[][2] = {
+        {1, 1}, {3, 3}, {4, 4}, {8, 8}, {5, 7}, {4, 12}, {16, 16}, {12, 20},
+        {31, 17}, {32, 32}
+    };
+    static const int counts[] = {1, 2, 7, 8, 9, 19};
+    static const int widths[] = {1, 2, 4, 8, 16};
+    static const struct {
+        int ndim, dims[8], perm[8];
+    } perms[] = {
+        {1, {9}, {0}},
+        {2, {5, 7}, {1, 0}},
+        {2, {16, 24}, {1, 0}},
+        {2, {1, 1}, {1, 0}},
+        {3, {3, 4, 5}, {0, 1, 2}},
+        {3, {9, 1, 17}, {2, 1, 0}},
+        {4, {2, 3, 4, 5}, {0, 2, 3, 1}},    /* NCHW to NHWC */
+        {4, {2, 4, 5, 3}, {0, 3, 1, 2}},    /* NHWC to NCHW */
+        {4, {1, 5, 1, 7}, {3, 1, 2, 0}},
+        {4, {1, 8, 16, 1}, {2, 0, 3, 1}},
+        {5, {2, 3, 1, 4, 5}, {4, 2, 0, 3, 1}},
+        {6, {2, 1, 3, 2, 1, 9}, {5, 3, 0, 2, 4, 1}}
+    };
+    int opt;
+
+    while ((opt = getopt(argc, argv, "vh")) != -1) {
+        switch (opt) {
+        case 'v':
+            verbose = 1;
+            break;
+        case 'h':
+            usage(argv);
+            return 0;
+        default:
+            usage(argv);
+            return 1;
+        }
+    }
+
+    for (unsigned s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        check_inplace(shapes[s][0], shapes[s][1]);
+        for (unsigned w = 0; w < sizeof(widths) / sizeof(widths[0]); w++)
+            check_width(shapes[s][0], shapes[s][1], widths[w]);
+    }
+    for (unsigned s = 0; s < sizeof(batch_shapes) / sizeof(batch_shapes[0]); s++) {
+        for (unsigned c = 0; c < sizeof(counts) / sizeof(counts[0]); c++)
+            check_batch(batch_shapes[s][0], batch_shapes[s][1], counts[c]);
+    }
+    for (unsigned p = 0; p < sizeof(perms) / sizeof(perms[0]); p++)
+        check_permute(perms[p].ndim, perms[p].dims, perms[p].perm);
+    check_rejects();
+
+    printf("%d of %d cases passed\n", cases - failures, cases);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,254 @@
+/*
+ * trans-ooc.c - Out-of-core transpose of memory-mapped matrix files
+ *
+ * Transposes an N x M matrix of 32-bit ints stored row-major in <in> into
+ * the M x N matrix in <out>, for matrices larger than RAM. Both files are
+ * mapped shared; A is walked in panels of whole rows sized so the panel and
+ * its transposed copy fit in the memory budget:
+ *
+ *   1. the panel (rows i0..i1 of A, contiguous in the file) is transposed
+ *      into a scratch buffer by one of the kernels registered in trans.c
+ *   2. each row of the scratch buffer is copied into B[j][i0..i1], a run of
+ *      (i1 - i0) ints, so B is written in long sequential pieces
+ *   3. the panel's pages are dropped with MADV_DONTNEED
+ *
+ * While a panel is being transposed, a helper thread faults in the next one
+ * (after an MADV_WILLNEED hint) so disk reads overlap the compute.
+ *
+ * Build:   gcc -O2 -pthread -o trans-ooc trans-ooc.c trans.c cachelab.c
+ * Example: ./trans-ooc -m 256 -c 8192 16384 A.bin B.bin
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "cachelab.h"
+
+extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern int func_counter;
+extern void registerFunctions(void);
+
+typedef void (*trans_fn)(int M, int N, int A[N][M], int B[M][N]);
+
+static long page_size;
+
+/* Next panel to fault in, handed to the prefetch thread */
+typedef struct {
+    const char *start;
+    size_t len;
+} prefetch_job;
+
+/*
+ * advise - madvise() over [ptr, ptr + len), widened to whole pages
+ */
+static void advise(const void *ptr, size_t len, int advice)
+{
+    unsigned long start = (unsigned long)ptr & ~(unsigned long)(page_size - 1);
+    unsigned long end = (unsigned long)ptr + len;
+
+    if (len > 0)
+        madvise((void *)start, end - start, advice);
+}
+
+/*
+ * prefetch_panel - Touch one byte per page so the next panel is resident
+ *     by the time the main thread reaches it
+ */
+static void *prefetch_panel(void *arg)
+{
+    prefetch_job *job = arg;
+    volatile char sink = 0;
+
+    for (size_t off = 0; off < job->len; off += (size_t)page_size)
+        sink ^= job->start[off];
+    (void)sink;
+    return NULL;
+}
+
+/*
+ * find_function - Registered transpose whose description contains name
+ */
+static trans_fn find_function(const char *name)
+{
+    for (int f = 0; f < func_counter; f++) {
+        if (strstr(func_list[f].description, name))
+            return func_list[f].func_ptr;
+    }
+    return NULL;
+}
+
+/*
+ * check_result - Compare B against A one panel of rows of A at a time
+ */
+static long check_result(int M, int N, const int *A, const int *B, long rows_per_panel)
+{
+    long bad = 0;
+
+    for (long i0 = 0; i0 < N; i0 += rows_per_panel) {
+        long i1 = i0 + rows_per_panel < N ? i0 + rows_per_panel : N;
+        for (long j = 0; j < M; j++) {
+            for (long i = i0; i < i1; i++) {
+                if (B[j * N + i] != A[i * M + j])
+                    bad++;
+            }
+        }
+        advise(A + i0 * M, (size_t)(i1 - i0) * (size_t)M * sizeof(int), MADV_DONTNEED);
+    }
+    return bad;
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-hc] [-m <MB>] [-f <name>] <M> <N> <in> <out>\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -m <MB>     Memory budget for a panel and its transposed copy (default 512).\n");
+    printf("  -f <name>   Kernel to use, matched against registered descriptions (default SIMD).\n");
+    printf("  -c          Check the result against the input afterwards.\n");
+    printf("<in> holds N rows of M ints, <out> is created with M rows of N ints.\n");
+    printf("Example: %s -m 256 -c 8192 16384 A.bin B.bin\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    long budget_mb = 512;
+    const char *kernel_name = "SIMD";
+    int check = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:f:ch")) != -1) {
+        switch (opt) {
+        case 'm':
+            budget_mb = atol(optarg);
+            break;
+        case 'f':
+            kernel_name = optarg;
+            break;
+        case 'c':
+            check = 1;
+            break;
+        case 'h':
+            usage(argv);
+            return 0;
+        default:
+            usage(argv);
+            return 1;
+        }
+    }
+    if (argc - optind != 4) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        return 1;
+    }
+
+    int M = atoi(argv[optind]);
+    int N = atoi(argv[optind + 1]);
+    const char *in_name = argv[optind + 2];
+    const char *out_name = argv[optind + 3];
+    size_t bytes = (size_t)M * (size_t)N * sizeof(int);
+    size_t row_bytes = (size_t)M * sizeof(int);
+
+    if (M <= 0 || N <= 0 || budget_mb <= 0) {
+        printf("Error: shape and budget must be positive\n");
+        return 1;
+    }
+
+    registerFunctions();
+    trans_fn kernel = find_function(kernel_name);
+    if (!kernel) {
+        printf("Error: no registered transpose matches \"%s\"\n", kernel_name);
+        return 1;
+    }
+    page_size = sysconf(_SC_PAGESIZE);
+
+    // a panel and its transposed copy share the budget, panels are whole tiles of rows
+    long rows = (long)((size_t)budget_mb * 1024 * 1024 / 2 / row_bytes);
+    rows = rows >= 16 ? rows / 16 * 16 : 8;
+    if (rows > N)
+        rows = N;
+
+    int in_fd = open(in_name, O_RDONLY);
+    if (in_fd < 0) {
+        printf("Error: cannot open %s: %s\n", in_name, strerror(errno));
+        return 1;
+    }
+    struct stat st;
+    if (fstat(in_fd, &st) < 0 || (size_t)st.st_size < bytes) {
+        printf("Error: %s is smaller than %d x %d ints\n", in_name, N, M);
+        return 1;
+    }
+    int out_fd = open(out_name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (out_fd < 0 || ftruncate(out_fd, (off_t)bytes) < 0) {
+        printf("Error: cannot create %s: %s\n", out_name, strerror(errno));
+        return 1;
+    }
+
+    const int *A = mmap(NULL, bytes, PROT_READ, MAP_SHARED, in_fd, 0);
+    int *B = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, out_fd, 0);
+    int *scratch = malloc((size_t)rows * row_bytes);
+    if (A == MAP_FAILED || B == MAP_FAILED || !scratch) {
+        printf("Error: cannot map the matrices: %s\n", strerror(errno));
+        return 1;
+    }
+    advise(A, bytes, MADV_SEQUENTIAL);
+
+    printf("%dx%d, panels of %ld rows (%ld MB budget), kernel \"%s\"\n",
+           M, N, rows, budget_mb, kernel_name);
+
+    pthread_t prefetcher;
+    prefetch_job job;
+    int prefetching = 0;
+
+    for (long i0 = 0; i0 < N; i0 += rows) {
+        long h = i0 + rows < N ? rows : N - i0;
+        const int *panel = A + i0 * M;
+
+        // start pulling in the next panel before working on this one
+        if (prefetching)
+            pthread_join(prefetcher, NULL);
+        prefetching = 0;
+        if (i0 + rows < N) {
+            long next_h = i0 + 2 * rows < N ? rows : N - i0 - rows;
+            job.start = (const char *)(panel + rows * M);
+            job.len = (size_t)next_h * row_bytes;
+            advise(job.start, job.len, MADV_WILLNEED);
+            prefetching = pthread_create(&prefetcher, NULL, prefetch_panel, &job) == 0;
+        }
+
+        kernel(M, (int)h, (int (*)[M])panel, (int (*)[h])scratch);
+        for (long j = 0; j < M; j++)
+            memcpy(B + j * N + i0, scratch + j * h, (size_t)h * sizeof(int));
+
+        advise(panel, (size_t)h * row_bytes, MADV_DONTNEED);
+    }
+    if (prefetching)
+        pthread_join(prefetcher, NULL);
+
+    if (msync(B, bytes, MS_SYNC) < 0) {
+        printf("Error: msync %s: %s\n", out_name, strerror(errno));
+        return 1;
+    }
+    if (check) {
+        long bad = check_result(M, N, A, B, rows);
+        printf("%s: %ld mismatches\n", bad ? "FAILED" : "OK", bad);
+        if (bad)
+            return 1;
+    }
+
+    free(scratch);
+    munmap((void *)A, bytes);
+    munmap(B, bytes);
+    close(in_fd);
+    close(out_fd);
+    return 0;
+}
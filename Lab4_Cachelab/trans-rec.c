@@ -0,0 +1,575 @@
+/*
+ * trans-rec.c - In-process address recorder for the transpose functions
+ *
+ * test-trans runs every transpose under valgrind's lackey tool to capture
+ * its addresses, which takes seconds per function. trans-rec gets the same
+ * addresses from the functions themselves, orders of magnitude faster: trans.c
+ * is compiled with -fsanitize=thread, which makes the compiler call a
+ * __tsan_readN/__tsan_writeN hook before every load and store. This file
+ * supplies those hooks (the sanitizer runtime is never linked). They append
+ * each address to an in-memory buffer, which is replayed through the cache
+ * model once the function returns.
+ *
+ * Every registered function is evaluated on every requested shape, the
+ * three test-trans shapes and 32x64 unless -M and -N pick one. The
+ * (function, shape) jobs run on a pool of threads, each with its own copy
+ * of A and B, its own buffer and its own cache model, and the results are
+ * gathered into one table. Each worker's matrices are mapped back onto the
+ * addresses of the A and B in this image, and whatever a function mallocs
+ * while it is recorded comes from the worker's own arena, emptied for
+ * every job and mapped to ARENA_BASE, so the traces do not depend on the
+ * worker or on how many there are.
+ *
+ * The recorded window mirrors test-trans exactly. It opens with tracegen's
+ * write to MARKER_START, includes tracegen's loads of the function pointer
+ * and of M and N, every access the function makes outside the stack, and
+ * closes with the write to MARKER_END. Addresses inside this executable are
+ * rebased to valgrind's load address for PIE binaries (-l), so they match
+ * what lackey reports. A and B can be moved to the addresses they have in a
+ * particular tracegen build (-A, from `nm tracegen`), which reproduces that
+ * build's miss counts.
+ *
+ * Not seen by the hooks: accesses inside uninstrumented library code
+ * (memcpy, getenv, ...) and accesses from threads other than the caller's.
+ * Kernels that only touch their arrays and trans.c's own data, vector
+ * loads and stores included, are recorded exactly. Heap blocks sit at
+ * ARENA_BASE rather than where valgrind's allocator would put them, so
+ * functions that malloc can be a few misses off test-trans.
+ *
+ * Build:   gcc -O0 -m64 -fsanitize=thread -c trans.c -o trans-rec.o
+ *          gcc -O2 -o trans-rec trans-rec.c trans-rec.o cachemodel.c cachelab.c -pthread
+ * Example: ./trans-rec -M 64 -N 64
+ *          ./trans-rec -j 8
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "cachelab.h"
+#include "cachemodel.h"
+
+/* Maximum array dimension */
+#define MAXN 256
+
+/* The description string for the transpose_submit() function */
+#define SUBMIT_DESCRIPTION "Transpose submission"
+
+/* Where valgrind maps a PIE executable on amd64 */
+#define VALGRIND_LOAD_BASE 0x108000ULL
+
+#define MAX_SHAPES 16
+#define MAX_THREADS 64
+
+/* Heap a recorded function may allocate, and where its blocks appear in the traces */
+#define ARENA_BYTES (16 << 20)
+#define ARENA_BASE 0x4a00000ULL
+
+/*
+ * Shapes test-trans scores, used when -M and -N are not given, plus a tall
+ * one (N > M) for the non-square paths
+ */
+static const int test_shapes[][2] = {{32, 32}, {64, 64}, {61, 67}, {32, 64}};
+
+extern void registerFunctions(void);
+extern trans_func_t func_list[MAX_TRANS_FUNCS];
+extern int func_counter;
+extern int is_transpose(int M, int N, int A[N][M], int B[M][N]);
+
+/* glibc's allocator, behind the malloc family below */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t size);
+extern void __libc_free(void *p);
+
+/* Start and end of this executable's image, from the linker */
+extern char __executable_start[];
+extern char _end[];
+
+/* Same globals as tracegen.c, only their addresses are used */
+static int A[MAXN][MAXN];
+static int B[MAXN][MAXN];
+static int M;
+static int N;
+static volatile char MARKER_START, MARKER_END;
+
+/* One recorded access */
+typedef struct {
+    unsigned long long addr;
+    char op;	/* 'L' or 'S' */
+    unsigned char size;
+} record;
+
+/* One registered function on one shape, and its score */
+typedef struct {
+    int f, M, N;
+    int correct;
+    unsigned int hits, misses, evictions;
+} job;
+
+/* Recording state of one pool thread */
+typedef struct {
+    int (*A)[MAXN];
+    int (*B)[MAXN];
+    record *records;
+    size_t recordCount, recordCap;
+    int recording;
+    unsigned long stackLo, stackHi;
+    char *heap;	/* ARENA_BYTES, its first heapUsed in use */
+    size_t heapUsed;
+    cacheModel *cache;
+} worker;
+
+/* Size of an arena block, in front of it, keeping blocks 16-byte aligned */
+typedef struct {
+    size_t size;
+    size_t pad;
+} arenaHeader;
+
+static __thread worker *current;
+
+static job jobs[MAX_TRANS_FUNCS * MAX_SHAPES];
+static int jobCount, nextJob;
+static pthread_mutex_t jobLock = PTHREAD_MUTEX_INITIALIZER;
+static int cacheS = 5, cacheE = 1, cacheB = 5;
+static const char *tracePrefix;
+static int singleShape;
+
+static unsigned long long loadBase = VALGRIND_LOAD_BASE;
+static unsigned long long baseA;	/* 0 to keep A and B where the image puts them */
+
+/*
+ * rebase - Address lackey would report for addr
+ */
+static unsigned long long rebase(const worker *w, unsigned long addr)
+{
+    unsigned long a = (unsigned long)A, b = (unsigned long)B;
+    unsigned long wa = (unsigned long)w->A, wb = (unsigned long)w->B;
+
+    // the worker's own matrices stand in for the image's A and B
+    if (addr >= wa && addr < wa + sizeof(A))
+        addr = a + (addr - wa);
+    else if (addr >= wb && addr < wb + sizeof(B))
+        addr = b + (addr - wb);
+    // the image may place B before A, so each is moved on its own
+    if (addr >= (unsigned long)w->heap && addr < (unsigned long)w->heap + ARENA_BYTES)
+        return ARENA_BASE + (addr - (unsigned long)w->heap);
+    if (baseA && addr >= a && addr < a + sizeof(A))
+        return baseA + (addr - a);
+    if (baseA && addr >= b && addr < b + sizeof(B))
+        return baseA + sizeof(A) + (addr - b);
+    if (addr >= (unsigned long)__executable_start && addr < (unsigned long)_end)
+        return loadBase + (addr - (unsigned long)__executable_start);
+    return addr;
+}
+
+/*
+ * recordAccess - Append one access, dropping the caller's stack like the
+ *     test-trans filter drops everything above 4GB
+ */
+static void recordAccess(const void *p, char op, unsigned char size)
+{
+    worker *w = current;
+    unsigned long addr = (unsigned long)p;
+
+    if (!w || !w->recording || (addr >= w->stackLo && addr < w->stackHi))
+        return;
+    if (w->recordCount == w->recordCap) {
+        w->recordCap = w->recordCap ? w->recordCap * 2 : 1 << 16;
+        w->records = __libc_realloc(w->records, w->recordCap * sizeof(record));
+        if (!w->records) {
+            printf("Error: out of memory recording the trace\n");
+            exit(1);
+        }
+    }
+    w->records[w->recordCount].addr = rebase(w, addr);
+    w->records[w->recordCount].op = op;
+    w->records[w->recordCount].size = size;
+    w->recordCount++;
+}
+
+/*
+ * arenaAlloc - A block of size bytes from the worker's arena
+ */
+static void *arenaAlloc(worker *w, size_t size)
+{
+    arenaHeader *h;
+    size_t need;
+
+    if (size > ARENA_BYTES) {
+        printf("Error: out of arena memory recording the trace\n");
+        exit(1);
+    }
+    need = sizeof(arenaHeader) + (size + 15) / 16 * 16;
+    if (need > ARENA_BYTES - w->heapUsed) {
+        printf("Error: out of arena memory recording the trace\n");
+        exit(1);
+    }
+    h = (arenaHeader *)(w->heap + w->heapUsed);
+    h->size = size;
+    w->heapUsed += need;
+    return h + 1;
+}
+
+static int inArena(const worker *w, const void *p)
+{
+    return w && w->heap && (const char *)p >= w->heap && (const char *)p < w->heap + ARENA_BYTES;
+}
+
+/*
+ * Allocation while recording goes to the arena, everything else to glibc.
+ * Arena blocks are only freed by emptying the arena for the next job.
+ */
+void *malloc(size_t size)
+{
+    worker *w = current;
+    return w && w->recording ? arenaAlloc(w, size) : __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    worker *w = current;
+    void *p;
+
+    if (!w || !w->recording)
+        return __libc_calloc(n, size);
+    if (size && n > ARENA_BYTES / size) {
+        printf("Error: out of arena memory recording the trace\n");
+        exit(1);
+    }
+    p = arenaAlloc(w, n * size);
+    memset(p, 0, n * size);
+    return p;
+}
+
+void *realloc(void *p, size_t size)
+{
+    worker *w = current;
+    void *q;
+    size_t old;
+
+    if (!inArena(w, p))
+        return w && w->recording && !p ? arenaAlloc(w, size) : __libc_realloc(p, size);
+    old = ((arenaHeader *)p - 1)->size;
+    q = w->recording ? arenaAlloc(w, size) : __libc_malloc(size);
+    if (q)
+        memcpy(q, p, old < size ? old : size);
+    return q;
+}
+
+void free(void *p)
+{
+    if (!inArena(current, p))
+        __libc_free(p);
+}
+
+/* Hooks called by code compiled with -fsanitize=thread */
+void __tsan_init(void) {}
+void __tsan_func_entry(void *pc) { (void)pc; }
+void __tsan_func_exit(void) {}
+void __tsan_vptr_update(void **vptr, void *val) { (void)vptr; (void)val; }
+void __tsan_read_range(void *p, unsigned long size) { recordAccess(p, 'L', (unsigned char)size); }
+void __tsan_write_range(void *p, unsigned long size) { recordAccess(p, 'S', (unsigned char)size); }
+
+#define TSAN_HOOKS(n)                                                         \
+    void __tsan_read##n(void *p) { recordAccess(p, 'L', n); }                 \
+    void __tsan_write##n(void *p) { recordAccess(p, 'S', n); }                \
+    void __tsan_unaligned_read##n(void *p) { recordAccess(p, 'L', n); }       \
+    void __tsan_unaligned_write##n(void *p) { recordAccess(p, 'S', n); }
+TSAN_HOOKS(1)
+TSAN_HOOKS(2)
+TSAN_HOOKS(4)
+TSAN_HOOKS(8)
+TSAN_HOOKS(16)
+
+/*
+ * findStack - Bounds of the calling thread's stack
+ */
+static void findStack(worker *w)
+{
+    pthread_attr_t attr;
+    void *addr;
+    size_t size;
+
+    if (pthread_getattr_np(pthread_self(), &attr) == 0 &&
+        pthread_attr_getstack(&attr, &addr, &size) == 0) {
+        w->stackLo = (unsigned long)addr;
+        w->stackHi = w->stackLo + size;
+        pthread_attr_destroy(&attr);
+    }
+}
+
+/*
+ * runFunction - Record job j the way tracegen runs it under valgrind
+ */
+static int runFunction(worker *w, const job *j)
+{
+    int m = j->M, n = j->N;
+    int (*a)[m] = (int (*)[m])w->A;
+    int (*b)[n] = (int (*)[n])w->B;
+
+    initMatrix(m, n, a, b);
+    w->recordCount = 0;
+    w->heapUsed = 0;
+    w->recording = 1;
+
+    recordAccess((const void *)&MARKER_START, 'S', 1);
+    recordAccess(&func_list[j->f].func_ptr, 'L', sizeof(func_list[j->f].func_ptr));
+    recordAccess(&M, 'L', sizeof(M));
+    recordAccess(&N, 'L', sizeof(N));
+    (*func_list[j->f].func_ptr)(m, n, a, b);
+    recordAccess((const void *)&MARKER_END, 'S', 1);
+
+    w->recording = 0;
+    return is_transpose(m, n, a, b);
+}
+
+/*
+ * writeTrace - Save the recorded window in the format test-trans feeds csim
+ */
+static void writeTrace(const worker *w, const char *name)
+{
+    FILE *fp = fopen(name, "w");
+
+    if (!fp) {
+        printf("Error: cannot open %s\n", name);
+        return;
+    }
+    for (size_t k = 0; k < w->recordCount; k++)
+        fprintf(fp, " %c %08llx,%u\n", w->records[k].op, w->records[k].addr, w->records[k].size);
+    fclose(fp);
+}
+
+/*
+ * evalJob - Record, optionally save and simulate one job
+ */
+static void evalJob(worker *w, job *j)
+{
+    j->correct = runFunction(w, j);
+
+    resetCacheModel(w->cache);
+    for (size_t k = 0; k < w->recordCount; k++)
+        cacheModelAccess(w->cache, w->records[k].addr);
+    j->hits = w->cache->hits;
+    j->misses = w->cache->misses;
+    j->evictions = w->cache->evictions;
+
+    if (tracePrefix) {
+        char name[256];
+        if (singleShape)
+            snprintf(name, sizeof(name), "%s%d", tracePrefix, j->f);
+        else
+            snprintf(name, sizeof(name), "%s%dx%d-%d", tracePrefix, j->M, j->N, j->f);
+        writeTrace(w, name);
+    }
+}
+
+/*
+ * poolThread - Take jobs off the shared list until it is empty
+ */
+static void *poolThread(void *arg)
+{
+    worker w;
+
+    (void)arg;
+    memset(&w, 0, sizeof(w));
+    w.A = malloc(sizeof(A));
+    w.B = malloc(sizeof(B));
+    w.heap = aligned_alloc(4096, ARENA_BYTES);
+    w.cache = createCacheModel(cacheS, cacheE, cacheB);
+    if (!w.A || !w.B || !w.heap || !w.cache) {
+        printf("Error: out of memory\n");
+        exit(1);
+    }
+    findStack(&w);
+    current = &w;
+
+    for (;;) {
+        pthread_mutex_lock(&jobLock);
+        int k = nextJob < jobCount ? nextJob++ : -1;
+        pthread_mutex_unlock(&jobLock);
+        if (k < 0)
+            break;
+        evalJob(&w, &jobs[k]);
+    }
+
+    current = NULL;
+    freeCacheModel(w.cache);
+    free(w.records);
+    free(w.A);
+    free(w.B);
+    free(w.heap);
+    return NULL;
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-h] [-M <rows> -N <cols>] [-F <num>] [-s <num>] [-E <num>] [-b <num>]\n"
+           "       [-l <hex>] [-A <hex>] [-t <prefix>] [-j <num>]\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -M <rows>   Number of matrix rows (max %d)\n", MAXN);
+    printf("  -N <cols>   Number of matrix columns (max %d)\n", MAXN);
+    printf("              Without -M and -N, all of 32x32, 64x64, 61x67 and 32x64 are evaluated.\n");
+    printf("  -F <num>    Only evaluate registered function <num>.\n");
+    printf("  -s/-E/-b    Cache geometry (default 5, 1, 5 as in test-trans).\n");
+    printf("  -l <hex>    Load address to rebase this executable to (default 0x%llx).\n",
+           VALGRIND_LOAD_BASE);
+    printf("  -A <hex>    Address of A in the tracegen build to match, B follows it.\n");
+    printf("  -t <prefix> Also write each function's trace to <prefix><num>\n"
+           "              (<prefix><M>x<N>-<num> when several shapes are evaluated).\n");
+    printf("  -j <num>    Worker threads (default: online CPUs).\n");
+    printf("Example: %s -M 64 -N 64\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int selected = -1;
+    int threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int shapes[MAX_SHAPES][2];
+    int numShapes = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "M:N:F:s:E:b:l:A:t:j:h")) != -1) {
+        switch (opt) {
+        case 'M':
+            M = atoi(optarg);
+            break;
+        case 'N':
+            N = atoi(optarg);
+            break;
+        case 'F':
+            selected = atoi(optarg);
+            break;
+        case 's':
+            cacheS = atoi(optarg);
+            break;
+        case 'E':
+            cacheE = atoi(optarg);
+            break;
+        case 'b':
+            cacheB = atoi(optarg);
+            break;
+        case 'l':
+            loadBase = strtoull(optarg, NULL, 16);
+            break;
+        case 'A':
+            baseA = strtoull(optarg, NULL, 16);
+            break;
+        case 't':
+            tracePrefix = optarg;
+            break;
+        case 'j':
+            threads = atoi(optarg);
+            break;
+        case 'h':
+            usage(argv);
+            return 0;
+        default:
+            usage(argv);
+            return 1;
+        }
+    }
+
+    if ((M == 0) != (N == 0)) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        return 1;
+    }
+    if (M > MAXN || N > MAXN || M < 0 || N < 0) {
+        printf("Error: M or N exceeds %d\n", MAXN);
+        usage(argv);
+        return 1;
+    }
+    if (M) {
+        shapes[0][0] = M;
+        shapes[0][1] = N;
+        numShapes = 1;
+        singleShape = 1;
+    } else {
+        numShapes = (int)(sizeof(test_shapes) / sizeof(test_shapes[0]));
+        memcpy(shapes, test_shapes, sizeof(test_shapes));
+    }
+    if (threads < 1)
+        threads = 1;
+    if (threads > MAX_THREADS)
+        threads = MAX_THREADS;
+
+    registerFunctions();
+    if (selected >= func_counter) {
+        printf("Error: only %d functions are registered\n", func_counter);
+        return 1;
+    }
+
+    for (int f = 0; f < func_counter; f++) {
+        if (selected >= 0 && f != selected)
+            continue;
+        for (int k = 0; k < numShapes; k++) {
+            jobs[jobCount].f = f;
+            jobs[jobCount].M = shapes[k][0];
+            jobs[jobCount].N = shapes[k][1];
+            jobCount++;
+        }
+    }
+    if (threads > jobCount)
+        threads = jobCount;
+
+    pthread_t pool[MAX_THREADS];
+    int started = 0;
+    for (int t = 1; t < threads; t++) {
+        if (pthread_create(&pool[started], NULL, poolThread, NULL) == 0)
+            started++;
+    }
+    poolThread(NULL);
+    for (int t = 0; t < started; t++)
+        pthread_join(pool[t], NULL);
+
+    int submission = -1;
+    for (int f = 0; f < func_counter; f++) {
+        if (strcmp(func_list[f].description, SUBMIT_DESCRIPTION) == 0)
+            submission = f;
+    }
+
+    if (singleShape) {
+        const job *sub = NULL;
+        for (int k = 0; k < jobCount; k++) {
+            const job *j = &jobs[k];
+            printf("func %d (%s): %shits:%u, misses:%u, evictions:%u\n", j->f,
+                   func_list[j->f].description, j->correct ? "" : "INCORRECT ",
+                   j->hits, j->misses, j->evictions);
+            if (j->f == submission)
+                sub = j;
+        }
+        if (sub) {
+            printf("\nSummary for official submission (func %d): correctness=%d misses=%u\n",
+                   submission, sub->correct, sub->misses);
+            printf("\nTEST_TRANS_RESULTS=%d:%u\n", sub->correct, sub->misses);
+        }
+        return 0;
+    }
+
+    // one row of misses per function, one column per shape
+    printf("%-4s %-42s", "func", "misses");
+    for (int k = 0; k < numShapes; k++) {
+        char name[32];
+        snprintf(name, sizeof(name), "%dx%d", shapes[k][0], shapes[k][1]);
+        printf(" %10s", name);
+    }
+    printf("\n");
+    for (int k = 0; k < jobCount; k += numShapes) {
+        printf("%-4d %-42.42s", jobs[k].f, func_list[jobs[k].f].description);
+        for (int x = 0; x < numShapes; x++) {
+            if (jobs[k + x].correct)
+                printf(" %10u", jobs[k + x].misses);
+            else
+                printf(" %10s", "INCORRECT");
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ * trans-tune.c - Simulator-in-the-loop auto-tuner for tiled transposes
+ *
+ * For every requested shape the tuner enumerates tile shapes, tile
+ * traversal orders and diagonal handling variants (see trans_plan.h),
+ * replays each candidate's exact access stream through the cache model
+ * and keeps the plan with the fewest misses. The winners are written as
+ * a dispatch table that tuned_transpose() in trans.c looks up at run time.
+ * With -a candidates are scored by the analytical model in planmodel.c
+ * instead, which counts each tile's misses in closed form and shares them
+ * between tiles (and candidates) with the same footprint. It agrees with
+ * the simulation on every shape whose rows span two or more cache lines,
+ * so the table is the same either way, and it abandons a candidate as
+ * soon as its misses pass the best so far.
+ *
+ * Build:   gcc -O2 -o trans-tune trans-tune.c cachemodel.c planmodel.c
+ * Example: ./trans-tune -s 5 -E 1 -b 5 -o trans_plans.h 32x32 64x64 61x67
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include "cachemodel.h"
+#include "planmodel.h"
+#include "trans_plan.h"
+
+#define MAX_SHAPES 64
+
+/* Base addresses of A and B, default to the layout of tracegen's arrays */
+static unsigned long long baseA = 0;
+static unsigned long long baseB = 256 * 256 * sizeof(int);
+
+/* Score candidates with predictPlan() rather than the cache model */
+static int analytic = 0;
+
+/* Tile edge lengths tried for both tile rows and tile columns */
+static const int tile_sizes[] = {1, 2, 3, 4, 6, 8, 12, 16, 24, 32};
+#define NUM_TILE_SIZES ((int)(sizeof(tile_sizes) / sizeof(tile_sizes[0])))
+
+static const char *order_names[TRAV_COUNT] = {
+    "TRAV_ROW", "TRAV_COL", "TRAV_SNAKE", "TRAV_DIAG"
+};
+static const char *diag_names[DIAG_COUNT] = {
+    "DIAG_NONE", "DIAG_DEFER", "DIAG_ROWBUF"
+};
+
+/*
+ * score_plan - Misses of plan p transposing the N x M matrix A into B on
+ *     a cold cache. A is row-major with M columns and B with N columns.
+ */
+static unsigned int score_plan(cacheModel *c, int M, int N, const trans_plan *p)
+{
+#define TUNE_READ(i, j) \
+    (cacheModelAccess(c, baseA + ((unsigned long long)(i) * (unsigned long long)M + (unsigned long long)(j)) * sizeof(int)), 0)
+#define TUNE_WRITE(j, i, v) \
+    ((void)(v), cacheModelAccess(c, baseB + ((unsigned long long)(j) * (unsigned long long)N + (unsigned long long)(i)) * sizeof(int)))
+
+    resetCacheModel(c);
+    PLAN_TRANSPOSE_BODY(M, N, p, TUNE_READ, TUNE_WRITE);
+    return c->misses;
+
+#undef TUNE_READ
+#undef TUNE_WRITE
+}
+
+/*
+ * tune_shape - Try every candidate plan for an N x M matrix and return the
+ *     one with the fewest misses. Ties keep the earlier, simpler candidate.
+ */
+static trans_plan tune_shape(cacheModel *c, int M, int N, unsigned int *best_misses)
+{
+    trans_plan best = {8, 8, TRAV_ROW, DIAG_NONE};
+    unsigned int limit = PLAN_NO_LIMIT;
+    planModel *pm = NULL;
+    *best_misses = ~0U;
+
+    // anything worse than the default plan can be abandoned from the start
+    if (analytic) {
+        planModelResult res;
+        pm = createPlanModel(M, N, baseA, baseB, c->s, c->E, c->b);
+        if (!pm)
+            fprintf(stderr, "Cannot model %dx%d analytically (A and B overlap or out of memory), simulating\n", M, N);
+        else if (predictPlan(pm, &best, PLAN_NO_LIMIT, &res) == 0)
+            limit = res.misses;
+    }
+
+    for (int r = 0; r < NUM_TILE_SIZES; r++) {
+        for (int q = 0; q < NUM_TILE_SIZES; q++) {
+            for (int order = 0; order < TRAV_COUNT; order++) {
+                for (int diag = 0; diag < DIAG_COUNT; diag++) {
+                    trans_plan p = {tile_sizes[r], tile_sizes[q], order, diag};
+                    unsigned int misses;
+                    if (pm) {
+                        planModelResult res;
+                        if (*best_misses <= limit)
+                            limit = *best_misses - 1;
+                        if (predictPlan(pm, &p, limit, &res) != 0)
+                            continue;
+                        misses = res.misses;
+                    } else {
+                        misses = score_plan(c, M, N, &p);
+                    }
+                    if (misses < *best_misses) {
+                        *best_misses = misses;
+                        best = p;
+                    }
+                }
+            }
+        }
+    }
+    freePlanModel(pm);
+    return best;
+}
+
+/*
+ * usage - Print usage info
+ */
+static void usage(char *argv[])
+{
+    printf("Usage: %s [-ha] [-s <num>] [-E <num>] [-b <num>] [-A <hex>] [-B <hex>] [-o <file>] <M>x<N>...\n", argv[0]);
+    printf("Options:\n");
+    printf("  -h          Print this help message.\n");
+    printf("  -a          Score candidates with the analytical model (same table).\n");
+    printf("  -s <num>    Number of set index bits (default 5).\n");
+    printf("  -E <num>    Number of lines per set (default 1).\n");
+    printf("  -b <num>    Number of block offset bits (default 5).\n");
+    printf("  -A <hex>    Base address of A (default 0).\n");
+    printf("  -B <hex>    Base address of B (default 0x40000).\n");
+    printf("  -o <file>   Write the dispatch table to <file> instead of stdout.\n");
+    printf("Example: %s -o trans_plans.h 32x32 64x64 61x67\n", argv[0]);
+}
+
+int main(int argc, char *argv[])
+{
+    int s = 5, E = 1, b = 5;
+    int opt;
+    const char *out_name = NULL;
+    int shapes[MAX_SHAPES][2];
+    int num_shapes = 0;
+
+    while ((opt = getopt(argc, argv, "s:E:b:A:B:o:ah")) != -1) {
+        switch (opt) {
+        case 's':
+            s = atoi(optarg);
+            break;
+        case 'E':
+            E = atoi(optarg);
+            break;
+        case 'b':
+            b = atoi(optarg);
+            break;
+        case 'A':
+            baseA = strtoull(optarg, NULL, 16);
+            break;
+        case 'B':
+            baseB = strtoull(optarg, NULL, 16);
+            break;
+        case 'o':
+            out_name = optarg;
+            break;
+        case 'a':
+            analytic = 1;
+            break;
+        case 'h':
+            usage(argv);
+            return 0;
+        default:
+            usage(argv);
+            return 1;
+        }
+    }
+
+    for (int i = optind; i < argc && num_shapes < MAX_SHAPES; i++) {
+        if (sscanf(argv[i], "%dx%d", &shapes[num_shapes][0], &shapes[num_shapes][1]) != 2 ||
+            shapes[num_shapes][0] <= 0 || shapes[num_shapes][1] <= 0) {
+            printf("Error: malformed shape %s\n", argv[i]);
+            return 1;
+        }
+        num_shapes++;
+    }
+    if (num_shapes == 0) {
+        printf("Error: Missing required argument\n");
+        usage(argv);
+        return 1;
+    }
+
+    FILE *out = out_name ? fopen(out_name, "w") : stdout;
+    if (!out) {
+        printf("Error: cannot open %s\n", out_name);
+        return 1;
+    }
+
+    cacheModel *c = createCacheModel(s, E, b);
+
+    fprintf(out, "/*\n * trans_plans.h - Generated by trans-tune, do not edit.\n");
+    fprintf(out, " *\n * Best plan per (M, N, s, E, b), with A at 0x%llx and B at 0x%llx.\n */\n",
+            baseA, baseB);
+    fprintf(out, "#ifndef TRANS_PLANS_H\n#define TRANS_PLANS_H\n\n#include \"trans_plan.h\"\n\n");
+    fprintf(out, "static const trans_plan_entry trans_plan_table[] = {\n");
+    for (int i = 0; i < num_shapes; i++) {
+        int M = shapes[i][0], N = shapes[i][1];
+        unsigned int misses;
+        trans_plan p = tune_shape(c, M, N, &misses);
+        fprintf(out, "    { %d, %d, %d, %d, %d, { %d, %d, %s, %s } }, /* %u misses */\n",
+                M, N, s, E, b, p.tile_rows, p.tile_cols,
+                order_names[p.order], diag_names[p.diag], misses);
+        if (out != stdout)
+            printf("%dx%d: %dx%d tiles, %s, %s, %u misses\n", M, N, p.tile_rows, p.tile_cols,
+                   order_names[p.order], diag_names[p.diag], misses);
+    }
+    fprintf(out, "};\n\n#define TRANS_PLAN_COUNT ((int)(sizeof(trans_plan_table) / sizeof(trans_plan_table[0])))\n\n");
+    fprintf(out, "#endif /* TRANS_PLANS_H */\n");
+
+    freeCacheModel(c);
+    if (out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -18,12 +18,30 @@
  * on a 1KB direct mapped cache with a block size of 32 bytes.
  */ 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
 #include "cachelab.h"
+#include "trans_plan.h"
+#include "trans_plans.h"
+#include "trans_kernels.h"
+#include "trans_layout.h"
+#include "trans_ops.h"
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TRANS_HAVE_X86 1
+#endif
 #define BLOCK 8
 int is_transpose(int M, int N, int A[N][M], int B[M][N]);
 void trans(int M, int N, int A[N][M], int B[M][N]);	// Basic transpose function
 void zigzag_transpose(int N_start, int M_start,int M, int N, int A[N][M], int B[M][N], int block);
 void case_transpose(int M, int N, int A[N][M], int B[M][N]);
+void plan_transpose(int M, int N, int A[N][M], int B[M][N], const trans_plan *plan);
+void oblivious_rec(int M, int N, int A[N][M], int B[M][N], int i0, int i1, int j0, int j1);
+void simd_transpose_cols(int M, int N, int A[N][M], int B[M][N], int j0, int j1, int stream);
 
 /* 
  * transpose_submit - This is the solution transpose function that you
@@ -399,133 +417,6 @@ void block_zigzag_trans_2(int M, int N, int A[N][M], int B[M][N])
     }
 }
 
-/*
-*	function GPT_transpose
-*	best results found when block = 8
-*/
-#define BLOCK_32 8
-#define BLOCK_64 8
-#define BLOCK_GENERIC 16
-
-char GPT_transpose_desc[] = "GPT Generated Transpose";
-
-void GPT_transpose(int M, int N, int A[N][M], int B[M][N])
-{
-    // -----------------------------
-    // Case 1: 32x32
-    // -----------------------------
-    if (M == 32 && N == 32) {
-        for (int ii = 0; ii < N; ii += BLOCK_32) {
-            for (int jj = 0; jj < M; jj += BLOCK_32) {
-                for (int i = ii; i < ii + BLOCK_32; i++) {
-                    int diag = -1;
-                    int diag_val = 0;
-                    for (int j = jj; j < jj + BLOCK_32; j++) {
-                        if (i == j) {
-                            diag = j;
-                            diag_val = A[i][j];
-                        } else {
-                            B[j][i] = A[i][j];
-                        }
-                    }
-                    if (diag != -1) {
-                        B[diag][diag] = diag_val;
-                    }
-                }
-            }
-        }
-        return;
-    }
-
-    // -----------------------------
-    // Case 2: 64x64
-    // -----------------------------
-    if (M == 64 && N == 64) {
-	for (int ii = 0; ii < 64; ii += BLOCK_64) {
-            for (int jj = 0; jj < 64; jj += BLOCK_64) {
-	        
-		int a0, a1, a2, a3, a4, a5, a6, a7; // 8 Local variables
-
-		for (int i=0; i<4; i++) {
-		    a0 = A[ii+i][jj+0];
-		    a1 = A[ii+i][jj+1];
-		    a2 = A[ii+i][jj+2];
-		    a3 = A[ii+i][jj+3];
-		    a4 = A[ii+i][jj+4];
-		    a5 = A[ii+i][jj+5];
-		    a6 = A[ii+i][jj+6];
-		    a7 = A[ii+i][jj+7];
-
-		    B[jj+0][ii+i] = a0;
-		    B[jj+1][ii+i] = a1;
-		    B[jj+2][ii+i] = a2;
-		    B[jj+3][ii+i] = a3;
-
-		    B[jj+0][ii+i+4] = a4;
-		    B[jj+1][ii+i+4] = a5;
-		    B[jj+2][ii+i+4] = a6;
-		    B[jj+3][ii+i+4] = a7;
-
-		}
-
-		for (int j = 0; j < 4; j++) {
-		    a0 = A[ii+4][jj+j];
-		    a1 = A[ii+5][jj+j];
-		    a2 = A[ii+6][jj+j];
-		    a3 = A[ii+7][jj+j];
-
-		    int b0, b1, b2, b3; // 4 Local variables
-
-		    b0 =B[jj+j][ii+4];
-		    b1 =B[jj+j][ii+5];
-		    b2 =B[jj+j][ii+6];
-		    b3 =B[jj+j][ii+7];
-
-		    B[jj+j][ii+4] = a0;
-		    B[jj+j][ii+5] = a1;
-		    B[jj+j][ii+6] = a2;
-		    B[jj+j][ii+7] = a3;
-
-		    B[jj+j+4][ii+0] = b0;
-		    B[jj+j+4][ii+1] = b1;
-		    B[jj+j+4][ii+2] = b2;
-		    B[jj+j+4][ii+3] = b3;
-		}
-
-		for (int i = 4; i < 8; i++) {
-		    a0 = A[ii+i][jj+4];
-		    a1 = A[ii+i][jj+5];
-		    a2 = A[ii+i][jj+6];
-		    a3 = A[ii+i][jj+7];
-
-		    B[jj+4][ii+i] = a0;
-		    B[jj+5][ii+i] = a1;
-		    B[jj+6][ii+i] = a2;
-		    B[jj+7][ii+i] = a3;
-
-		}
-            }
-	}
-
-        return;
-    }
-
-    // -----------------------------
-    // Case 3: Generic sizes (e.g., 61x67)
-    // -----------------------------
-    for (int ii = 0; ii < N; ii += BLOCK_GENERIC) {
-        for (int jj = 0; jj < M; jj += BLOCK_GENERIC) {
-            int i_end = (ii + BLOCK_GENERIC < N) ? ii + BLOCK_GENERIC : N;
-            int j_end = (jj + BLOCK_GENERIC < M) ? jj + BLOCK_GENERIC : M;
-            for (int i = ii; i < i_end; i++) {
-                for (int j = jj; j < j_end; j++) {
-                    B[j][i] = A[i][j];
-                }
-            }
-        }
-    }
-}
-
 /*
 *	function block_snake_trans
 *	basic blocking snake function made to run with asymetric matricies with any matrix size
@@ -698,134 +589,1225 @@ void block_square_diag_trans(int M, int N, int A[N][M], int B[M][N])
 
 /*
 *	function case_transpose
-*	a blocking function that takes each submission case and uses the optimal algorithm to get the transpose 
-*	For the 64x64 case the registers are loaded 8 at a time and then stored 8 at a time
+*	picks the kernel generated for each submission case from case_kernels, see trans_kernels.h
+*	32x32 defers the diagonal of each 8x8 tile, 64x64 moves 8x8 tiles as 4x4 quadrants through
+*	8 registers, every other shape uses plain 16x16 tiles
 *	best results found when block = 8 for 32x32 and 64x64
 */
-#define BLOCK_32 8
-#define BLOCK_64 8
-#define BLOCK_GENERIC 16
+TRANS_KERNEL_TILED(kernel_8x8_defer, int, 8, 8, DIAG_DEFER)
+TRANS_KERNEL_SPLIT8(kernel_split8, int)
+TRANS_KERNEL_TILED(kernel_16x16, int, 16, 16, DIAG_NONE)
+
+static const struct {
+    int M, N;
+    void (*fn)(int M, int N, int A[N][M], int B[M][N]);
+} case_kernels[] = {
+    {32, 32, kernel_8x8_defer},
+    {64, 64, kernel_split8},
+};
 
-char case_transpose_desc[] = "GPT Generated Transpose";
+char case_transpose_desc[] = "Shape dispatched generated kernels";
 
 void case_transpose(int M, int N, int A[N][M], int B[M][N])
 {
-    // -----------------------------
-    // Case 1: 32x32
-    // -----------------------------
-    if (M == 32 && N == 32) {
-        for (int ii = 0; ii < N; ii += BLOCK_32) {
-            for (int jj = 0; jj < M; jj += BLOCK_32) {
-                for (int i = ii; i < ii + BLOCK_32; i++) {
-                    int diag = -1;
-                    int diag_val = 0;
-                    for (int j = jj; j < jj + BLOCK_32; j++) {
-                        if (i == j) {
-                            diag = j;
-                            diag_val = A[i][j];
-                        } else {
-                            B[j][i] = A[i][j];
-                        }
-                    }
-                    if (diag != -1) {
-                        B[diag][diag] = diag_val;
-                    }
+    for (int k = 0; k < (int)(sizeof(case_kernels) / sizeof(case_kernels[0])); k++) {
+        if (case_kernels[k].M == M && case_kernels[k].N == N) {
+            case_kernels[k].fn(M, N, A, B);
+            return;
+        }
+    }
+    kernel_16x16(M, N, A, B);
+}
+
+
+
+/*
+*	function plan_transpose
+*	tiled transpose driven by a trans_plan (tile shape, traversal order, diagonal handling)
+*	see trans_plan.h, the same body is scored against the cache model by trans-tune
+*/
+void plan_transpose(int M, int N, int A[N][M], int B[M][N], const trans_plan *plan)
+{
+#define PLAN_READ(i, j) A[i][j]
+#define PLAN_WRITE(j, i, v) B[j][i] = (v)
+    PLAN_TRANSPOSE_BODY(M, N, plan, PLAN_READ, PLAN_WRITE);
+#undef PLAN_READ
+#undef PLAN_WRITE
+}
+
+/*
+*	function tuned_transpose
+*	looks up the plan trans-tune found for this shape on the graded cache (s=5, E=1, b=5)
+*	in the generated trans_plans.h table. Shapes that were not tuned use 8x8 row tiles
+*	with the diagonal deferred, like the 32x32 case of case_transpose
+*	regenerate the table with: ./trans-tune -o trans_plans.h 32x32 64x64 61x67 ...
+*/
+char tuned_transpose_desc[] = "Auto-tuned plan transpose";
+void tuned_transpose(int M, int N, int A[N][M], int B[M][N])
+{
+    // copied to the stack so the kernel's plan reads don't compete with A and B for the cache
+    trans_plan plan = {8, 8, TRAV_ROW, DIAG_DEFER};
+
+    for (int k = 0; k < TRANS_PLAN_COUNT; k++) {
+        const trans_plan_entry *e = &trans_plan_table[k];
+        if (e->M == M && e->N == N && e->s == 5 && e->E == 1 && e->b == 5) {
+            plan = e->plan;
+            break;
+        }
+    }
+
+    plan_transpose(M, N, A, B, &plan);
+}
+
+/*
+*	function oblivious_transpose
+*	cache-oblivious recursive transpose for any shape, no block size to tune
+*	the longer side of the current sub-matrix is split in half until both sides are at most
+*	OBLIVIOUS_BASE, then the sub-matrix is transposed by a register-blocked base case
+*/
+#define OBLIVIOUS_BASE 8
+
+char oblivious_transpose_desc[] = "Cache-oblivious recursive transpose";
+void oblivious_transpose(int M, int N, int A[N][M], int B[M][N])
+{
+    oblivious_rec(M, N, A, B, 0, N, 0, M);
+}
+
+/*
+*	function oblivious_rec
+*	transposes rows i0..i1-1 and columns j0..j1-1 of A into B
+*	splits are rounded to a multiple of OBLIVIOUS_BASE so base cases line up with cache blocks
+*/
+void oblivious_rec(int M, int N, int A[N][M], int B[M][N], int i0, int i1, int j0, int j1)
+{
+    int rows = i1 - i0;
+    int cols = j1 - j0;
+
+    if (rows > OBLIVIOUS_BASE || cols > OBLIVIOUS_BASE) {
+        if (rows >= cols) {
+            int mid = i0 + (rows / 2 + OBLIVIOUS_BASE - 1) / OBLIVIOUS_BASE * OBLIVIOUS_BASE;
+            if (mid >= i1)
+                mid = i0 + rows / 2;
+            oblivious_rec(M, N, A, B, i0, mid, j0, j1);
+            oblivious_rec(M, N, A, B, mid, i1, j0, j1);
+        } else {
+            int mid = j0 + (cols / 2 + OBLIVIOUS_BASE - 1) / OBLIVIOUS_BASE * OBLIVIOUS_BASE;
+            if (mid >= j1)
+                mid = j0 + cols / 2;
+            oblivious_rec(M, N, A, B, i0, i1, j0, mid);
+            oblivious_rec(M, N, A, B, i0, i1, mid, j1);
+        }
+        return;
+    }
+
+    // base case: load a full row of the tile into locals before writing any of it,
+    // so a diagonal tile never evicts the row of A it is still reading
+    if (cols == 8) {
+        int a0, a1, a2, a3, a4, a5, a6, a7;
+        for (int i = i0; i < i1; i++) {
+            a0 = A[i][j0+0];
+            a1 = A[i][j0+1];
+            a2 = A[i][j0+2];
+            a3 = A[i][j0+3];
+            a4 = A[i][j0+4];
+            a5 = A[i][j0+5];
+            a6 = A[i][j0+6];
+            a7 = A[i][j0+7];
+
+            B[j0+0][i] = a0;
+            B[j0+1][i] = a1;
+            B[j0+2][i] = a2;
+            B[j0+3][i] = a3;
+            B[j0+4][i] = a4;
+            B[j0+5][i] = a5;
+            B[j0+6][i] = a6;
+            B[j0+7][i] = a7;
+        }
+        return;
+    }
+
+    for (int i = i0; i < i1; i++) {
+        for (int j = j0; j < j1; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
+
+/*
+*	SIMD 8x8 register-blocked transpose
+*	native fast path for real hardware, where instruction throughput rather than simulated misses
+*	is the limit. each 8x8 tile is loaded as 8 rows, transposed in registers with an
+*	unpack/permute network and stored as 8 rows of B. AVX2 is used when the CPU has it, SSE2
+*	otherwise, and the scalar kernels remain the fallback on other architectures
+*	for matrices bigger than SIMD_STREAM_BYTES, B is written with non-temporal streaming stores
+*	when its rows are 32-byte aligned, so the output does not evict A from the cache
+*/
+#define SIMD_STREAM_BYTES (4 << 20)
+#define SIMD_TILE 64
+
+#ifdef TRANS_HAVE_X86
+__attribute__((target("avx2")))
+static void transpose_8x8_avx2(const int *src, int src_stride, int *dst, int dst_stride, int stream)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)(src + 0 * src_stride));
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)(src + 1 * src_stride));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)(src + 2 * src_stride));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)(src + 3 * src_stride));
+    __m256i r4 = _mm256_loadu_si256((const __m256i *)(src + 4 * src_stride));
+    __m256i r5 = _mm256_loadu_si256((const __m256i *)(src + 5 * src_stride));
+    __m256i r6 = _mm256_loadu_si256((const __m256i *)(src + 6 * src_stride));
+    __m256i r7 = _mm256_loadu_si256((const __m256i *)(src + 7 * src_stride));
+
+    // interleave 32-bit elements of row pairs
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    // interleave 64-bit pairs, giving 4x4 transposes within each 128-bit lane
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    // swap 128-bit lanes between the top and bottom halves
+    __m256i o0 = _mm256_permute2x128_si256(u0, u4, 0x20);
+    __m256i o1 = _mm256_permute2x128_si256(u1, u5, 0x20);
+    __m256i o2 = _mm256_permute2x128_si256(u2, u6, 0x20);
+    __m256i o3 = _mm256_permute2x128_si256(u3, u7, 0x20);
+    __m256i o4 = _mm256_permute2x128_si256(u0, u4, 0x31);
+    __m256i o5 = _mm256_permute2x128_si256(u1, u5, 0x31);
+    __m256i o6 = _mm256_permute2x128_si256(u2, u6, 0x31);
+    __m256i o7 = _mm256_permute2x128_si256(u3, u7, 0x31);
+
+    if (stream) {
+        _mm256_stream_si256((__m256i *)(dst + 0 * dst_stride), o0);
+        _mm256_stream_si256((__m256i *)(dst + 1 * dst_stride), o1);
+        _mm256_stream_si256((__m256i *)(dst + 2 * dst_stride), o2);
+        _mm256_stream_si256((__m256i *)(dst + 3 * dst_stride), o3);
+        _mm256_stream_si256((__m256i *)(dst + 4 * dst_stride), o4);
+        _mm256_stream_si256((__m256i *)(dst + 5 * dst_stride), o5);
+        _mm256_stream_si256((__m256i *)(dst + 6 * dst_stride), o6);
+        _mm256_stream_si256((__m256i *)(dst + 7 * dst_stride), o7);
+    } else {
+        _mm256_storeu_si256((__m256i *)(dst + 0 * dst_stride), o0);
+        _mm256_storeu_si256((__m256i *)(dst + 1 * dst_stride), o1);
+        _mm256_storeu_si256((__m256i *)(dst + 2 * dst_stride), o2);
+        _mm256_storeu_si256((__m256i *)(dst + 3 * dst_stride), o3);
+        _mm256_storeu_si256((__m256i *)(dst + 4 * dst_stride), o4);
+        _mm256_storeu_si256((__m256i *)(dst + 5 * dst_stride), o5);
+        _mm256_storeu_si256((__m256i *)(dst + 6 * dst_stride), o6);
+        _mm256_storeu_si256((__m256i *)(dst + 7 * dst_stride), o7);
+    }
+}
+
+// 4x4 SSE2 transpose, used four times per 8x8 tile when AVX2 is not available
+static void transpose_4x4_sse2(const int *src, int src_stride, int *dst, int dst_stride, int stream)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(src + 0 * src_stride));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(src + 1 * src_stride));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 2 * src_stride));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 3 * src_stride));
+
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    __m128i o0 = _mm_unpacklo_epi64(t0, t1);
+    __m128i o1 = _mm_unpackhi_epi64(t0, t1);
+    __m128i o2 = _mm_unpacklo_epi64(t2, t3);
+    __m128i o3 = _mm_unpackhi_epi64(t2, t3);
+
+    if (stream) {
+        _mm_stream_si128((__m128i *)(dst + 0 * dst_stride), o0);
+        _mm_stream_si128((__m128i *)(dst + 1 * dst_stride), o1);
+        _mm_stream_si128((__m128i *)(dst + 2 * dst_stride), o2);
+        _mm_stream_si128((__m128i *)(dst + 3 * dst_stride), o3);
+    } else {
+        _mm_storeu_si128((__m128i *)(dst + 0 * dst_stride), o0);
+        _mm_storeu_si128((__m128i *)(dst + 1 * dst_stride), o1);
+        _mm_storeu_si128((__m128i *)(dst + 2 * dst_stride), o2);
+        _mm_storeu_si128((__m128i *)(dst + 3 * dst_stride), o3);
+    }
+}
+
+static void transpose_8x8_sse2(const int *src, int src_stride, int *dst, int dst_stride, int stream)
+{
+    transpose_4x4_sse2(src, src_stride, dst, dst_stride, stream);
+    transpose_4x4_sse2(src + 4, src_stride, dst + 4 * dst_stride, dst_stride, stream);
+    transpose_4x4_sse2(src + 4 * src_stride, src_stride, dst + 4, dst_stride, stream);
+    transpose_4x4_sse2(src + 4 * src_stride + 4, src_stride, dst + 4 * dst_stride + 4, dst_stride, stream);
+}
+#endif
+
+/*
+*	simd_can_stream
+*	streaming stores pay off only once the matrix is well past the cache, and need every
+*	row of B to start on a vector boundary
+*/
+static int simd_can_stream(int M, int N, int *B)
+{
+#ifdef TRANS_HAVE_X86
+    int vec_bytes = __builtin_cpu_supports("avx2") ? 32 : 16;
+    return (long)M * N * (long)sizeof(int) > SIMD_STREAM_BYTES &&
+           ((unsigned long)B % (unsigned long)vec_bytes) == 0 &&
+           (N * (int)sizeof(int)) % vec_bytes == 0;
+#else
+    (void)M; (void)N; (void)B;
+    return 0;
+#endif
+}
+
+/*
+*	simd_transpose_cols
+*	transposes columns j0..j1-1 of A into rows j0..j1-1 of B
+*	shared by simd_transpose and the per-thread bands of parallel_transpose
+*/
+void simd_transpose_cols(int M, int N, int A[N][M], int B[M][N], int j0, int j1, int stream)
+{
+    int N8 = N - N % 8;
+    int J8 = j0 + (j1 - j0) / 8 * 8;
+
+#ifdef TRANS_HAVE_X86
+    void (*kernel)(const int *, int, int *, int, int) =
+        __builtin_cpu_supports("avx2") ? transpose_8x8_avx2 : transpose_8x8_sse2;
+
+    for (int ii = 0; ii < N8; ii += SIMD_TILE) {
+        int iend = ii + SIMD_TILE < N8 ? ii + SIMD_TILE : N8;
+        for (int jj = j0; jj < J8; jj += SIMD_TILE) {
+            int jend = jj + SIMD_TILE < J8 ? jj + SIMD_TILE : J8;
+            for (int j = jj; j < jend; j += 8) {
+                for (int i = ii; i < iend; i += 8) {
+                    kernel(&A[i][j], M, &B[j][i], N, stream);
                 }
             }
         }
-        return;
     }
+    if (stream)
+        _mm_sfence();
+#else
+    (void)stream;
+    for (int ii = 0; ii < N8; ii += 8) {
+        for (int jj = j0; jj < J8; jj += 8) {
+            for (int i = ii; i < ii + 8; i++) {
+                for (int j = jj; j < jj + 8; j++) {
+                    B[j][i] = A[i][j];
+                }
+            }
+        }
+    }
+#endif
 
-    // -----------------------------
-    // Case 2: 64x64
-    // -----------------------------
-    if (M == 64 && N == 64) {
-	for (int ii = 0; ii < 64; ii += BLOCK_64) {
-            for (int jj = 0; jj < 64; jj += BLOCK_64) {
-	        
-		int a0, a1, a2, a3, a4, a5, a6, a7; // 8 Local variables
-			// load in 8 values at a time
-		for (int i=0; i<4; i++) {
-		    a0 = A[ii+i][jj+0];
-		    a1 = A[ii+i][jj+1];
-		    a2 = A[ii+i][jj+2];
-		    a3 = A[ii+i][jj+3];
-		    a4 = A[ii+i][jj+4];
-		    a5 = A[ii+i][jj+5];
-		    a6 = A[ii+i][jj+6];
-		    a7 = A[ii+i][jj+7];
-			// Then write the 8 values at the same time
-		    B[jj+0][ii+i] = a0;
-		    B[jj+1][ii+i] = a1;
-		    B[jj+2][ii+i] = a2;
-		    B[jj+3][ii+i] = a3;
-
-		    B[jj+0][ii+i+4] = a4;
-		    B[jj+1][ii+i+4] = a5;
-		    B[jj+2][ii+i+4] = a6;
-		    B[jj+3][ii+i+4] = a7;
+    // transpose the ragged right and bottom edges with scalar code
+    for (int i = 0; i < N; i++) {
+        for (int j = (i < N8 ? J8 : j0); j < j1; j++) {
+            B[j][i] = A[i][j];
+        }
+    }
+}
 
-		}
+char simd_transpose_desc[] = "SIMD 8x8 register-blocked transpose";
+void simd_transpose(int M, int N, int A[N][M], int B[M][N])
+{
+    simd_transpose_cols(M, N, A, B, 0, M, simd_can_stream(M, N, &B[0][0]));
+}
+
+/*
+*	parallel tiled transpose
+*	splits B into one contiguous band of ints per thread and runs simd_transpose_cols on the
+*	whole rows of each band. band edges are moved up to the next cache line boundary of B,
+*	which may fall inside a row, so every output line is written by exactly one thread and
+*	there is no false sharing; the partial rows at either end of a band are done with scalar
+*	code. the bands depend on M, N, the thread count and where B starts within a line
+*	matrices under PAR_MIN_BYTES run on the calling thread alone, which keeps the traces of the
+*	lab shapes identical to simd_transpose. TRANS_THREADS overrides the thread count; it is read
+*	once, on the first call big enough to split
+*/
+#define PAR_MIN_BYTES (1 << 20)
+#define PAR_MAX_THREADS 64
+#define PAR_LINE_BYTES 64
+
+typedef struct {
+    int M, N;
+    int *A, *B;
+    long from, to;	// ints of B, row-major
+    int stream;
+} par_band;
+
+static void *parallel_band(void *arg)
+{
+    par_band *band = arg;
+    int M = band->M, N = band->N;
+    int (*A)[M] = (int (*)[M])band->A;
+    int (*B)[N] = (int (*)[N])band->B;
+    int j0 = (int)(band->from / N), i0 = (int)(band->from % N);
+    int j1 = (int)(band->to / N), i1 = (int)(band->to % N);
+
+    if (j0 == j1) {
+        for (int i = i0; i < i1; i++)
+            B[j0][i] = A[i][j0];
+        return NULL;
+    }
+    // the rest of the row the band starts in, its whole rows, then the start of its last row
+    if (i0 > 0) {
+        for (int i = i0; i < N; i++)
+            B[j0][i] = A[i][j0];
+        j0++;
+    }
+    simd_transpose_cols(M, N, A, B, j0, j1, band->stream);
+    for (int i = 0; i < i1; i++)
+        B[j1][i] = A[i][j1];
+    return NULL;
+}
 
-		for (int j = 0; j < 4; j++) {
-		    a0 = A[ii+4][jj+j];
-		    a1 = A[ii+5][jj+j];
-		    a2 = A[ii+6][jj+j];
-		    a3 = A[ii+7][jj+j];
+// TRANS_THREADS or the online cpu count, looked up once (sysconf reads /sys)
+static long par_max_threads;
+static pthread_once_t par_max_once = PTHREAD_ONCE_INIT;
 
-		    int b0, b1, b2, b3; // 4 Local variables
+static void parallel_init(void)
+{
+    const char *env = getenv("TRANS_THREADS");
+    long threads = env ? atol(env) : sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (threads < 1)
+        threads = 1;
+    if (threads > PAR_MAX_THREADS)
+        threads = PAR_MAX_THREADS;
+    par_max_threads = threads;
+}
 
-		    b0 =B[jj+j][ii+4];
-		    b1 =B[jj+j][ii+5];
-		    b2 =B[jj+j][ii+6];
-		    b3 =B[jj+j][ii+7];
+static int parallel_threads(int M, int N)
+{
+    long threads;
+
+    if ((long)M * N * (long)sizeof(int) < PAR_MIN_BYTES)
+        return 1;
+    pthread_once(&par_max_once, parallel_init);
+    threads = par_max_threads;
+    if (threads > (M + 7) / 8)
+        threads = (M + 7) / 8;
+    return (int)threads;
+}
 
-		    B[jj+j][ii+4] = a0;
-		    B[jj+j][ii+5] = a1;
-		    B[jj+j][ii+6] = a2;
-		    B[jj+j][ii+7] = a3;
+char parallel_transpose_desc[] = "Multi-threaded banded transpose";
+void parallel_transpose(int M, int N, int A[N][M], int B[M][N])
+{
+    int threads = parallel_threads(M, N);
+    int stream = simd_can_stream(M, N, &B[0][0]);
+    par_band bands[PAR_MAX_THREADS];
+    pthread_t tids[PAR_MAX_THREADS];
+    int started[PAR_MAX_THREADS];
+    long total = (long)M * N, from = 0;
+
+    for (int t = 0; t < threads; t++) {
+        long end = total * (t + 1) / threads;
+        if (t < threads - 1) {
+            // up to the next cache line boundary of B, wherever it falls in a row
+            uintptr_t addr = (uintptr_t)&B[0][0] + (uintptr_t)end * sizeof(int);
+            end += (long)((PAR_LINE_BYTES - addr % PAR_LINE_BYTES) % PAR_LINE_BYTES / sizeof(int));
+            if (end > total)
+                end = total;
+        }
+        bands[t] = (par_band){M, N, &A[0][0], &B[0][0], from, end, stream};
+        from = end;
+    }
 
-		    B[jj+j+4][ii+0] = b0;
-		    B[jj+j+4][ii+1] = b1;
-		    B[jj+j+4][ii+2] = b2;
-		    B[jj+j+4][ii+3] = b3;
-		}
+    // the calling thread takes band 0, a band whose thread fails to start runs inline
+    for (int t = 1; t < threads; t++) {
+        started[t] = bands[t].from < bands[t].to &&
+                     pthread_create(&tids[t], NULL, parallel_band, &bands[t]) == 0;
+    }
+    parallel_band(&bands[0]);
+    for (int t = 1; t < threads; t++) {
+        if (started[t])
+            pthread_join(tids[t], NULL);
+        else
+            parallel_band(&bands[t]);
+    }
+}
+
+/*
+*	in-place transpose
+*	transposes the N x M row-major matrix in data into the M x N matrix in the same buffer, so
+*	only one copy has to fit in memory. returns 0, or -1 if the visited bitmap can't be allocated
+*	square matrices swap mirrored 8x8 tiles. rectangular matrices whose sides share a tile
+*	size t are transposed in four passes, each either moving contiguous runs of t or t*t ints
+*	or transposing t x t tiles, so every memory access touches whole runs:
+*	    (I,a,J,b) -> (I,J,a,b) -> (I,J,b,a) -> (J,I,b,a) -> (J,b,I,a)
+*	where row i = I*t+a and column j = J*t+b. other shapes follow cycles element by element
+*/
+#define INPLACE_MAX_TILE 16
 
-		for (int i = 4; i < 8; i++) {
-		    a0 = A[ii+i][jj+4];
-		    a1 = A[ii+i][jj+5];
-		    a2 = A[ii+i][jj+6];
-		    a3 = A[ii+i][jj+7];
+// in-place transpose of a rows x cols matrix of run-int elements by following permutation cycles
+static void inplace_cycles(int *data, long rows, long cols, int run, unsigned char *visited)
+{
+    int tmp[INPLACE_MAX_TILE * INPLACE_MAX_TILE];
+    long last = rows * cols - 1;
+    size_t bytes = (size_t)run * sizeof(int);
 
-		    B[jj+4][ii+i] = a0;
-		    B[jj+5][ii+i] = a1;
-		    B[jj+6][ii+i] = a2;
-		    B[jj+7][ii+i] = a3;
+    if (rows == 1 || cols == 1)
+        return;
+    memset(visited, 0, (size_t)(last + 8) / 8);
+    for (long start = 1; start < last; start++) {
+        if (visited[start / 8] & (1 << (start % 8)))
+            continue;
+        // walk the cycle backwards, pulling each run from the slot that belongs in it
+        long pos = start;
+        memcpy(tmp, data + start * run, bytes);
+        for (;;) {
+            long src = pos * cols % last;
+            visited[pos / 8] |= (unsigned char)(1 << (pos % 8));
+            if (src == start)
+                break;
+            memcpy(data + pos * run, data + src * run, bytes);
+            pos = src;
+        }
+        memcpy(data + pos * run, tmp, bytes);
+    }
+}
 
-		}
+// transpose every contiguous t x t tile of data in place
+static void inplace_tiles(int *data, long tiles, int t)
+{
+    for (long k = 0; k < tiles; k++) {
+        int *tile = data + k * t * t;
+        for (int a = 0; a < t; a++) {
+            for (int b = a + 1; b < t; b++) {
+                int tmp = tile[a * t + b];
+                tile[a * t + b] = tile[b * t + a];
+                tile[b * t + a] = tmp;
             }
-	}
+        }
+    }
+}
 
+// square matrices swap each tile above the diagonal with its mirror below it
+static void inplace_square(int N, int *data)
+{
+    for (int ii = 0; ii < N; ii += BLOCK) {
+        for (int jj = ii; jj < N; jj += BLOCK) {
+            int iend = ii + BLOCK < N ? ii + BLOCK : N;
+            int jend = jj + BLOCK < N ? jj + BLOCK : N;
+            for (int i = ii; i < iend; i++) {
+                for (int j = (ii == jj ? i + 1 : jj); j < jend; j++) {
+                    int tmp = data[(long)i * N + j];
+                    data[(long)i * N + j] = data[(long)j * N + i];
+                    data[(long)j * N + i] = tmp;
+                }
+            }
+        }
+    }
+}
+
+int inplace_transpose(int M, int N, int *data)
+{
+    int t;
+    unsigned char *visited;
+
+    if (M == N) {
+        inplace_square(N, data);
+        return 0;
+    }
+    for (t = INPLACE_MAX_TILE; t > 1; t /= 2) {
+        if (M % t == 0 && N % t == 0)
+            break;
+    }
+    if (t == 1) {
+        visited = malloc(((size_t)M * (size_t)N + 8) / 8);
+        if (!visited)
+            return -1;
+        inplace_cycles(data, N, M, 1, visited);
+        free(visited);
+        return 0;
+    }
+
+    long n = N / t, m = M / t;
+    long band = (long)t * M;
+    // one bitmap, reused by every pass: the widest is n*m, m*t or n*t bits
+    long bits = n * m;
+    if (m * t > bits)
+        bits = m * t;
+    if (n * t > bits)
+        bits = n * t;
+    visited = malloc((size_t)(bits + 8) / 8);
+    if (!visited)
+        return -1;
+    for (long I = 0; I < n; I++)
+        inplace_cycles(data + I * band, t, m, t, visited);
+    inplace_tiles(data, n * m, t);
+    inplace_cycles(data, n, m, t * t, visited);
+    band = (long)t * N;
+    for (long J = 0; J < m; J++)
+        inplace_cycles(data + J * band, n, t, t, visited);
+    free(visited);
+    return 0;
+}
+
+// registered wrapper: copy A into B, then transpose B in place
+char inplace_transpose_desc[] = "In-place blocked/cycle-following transpose";
+void inplace_transpose_reg(int M, int N, int A[N][M], int B[M][N])
+{
+    int *data = &B[0][0];
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < M; j++) {
+            data[(long)i * M + j] = A[i][j];
+        }
+    }
+    inplace_transpose(M, N, data);
+}
+
+/*
+*	batched small-matrix transpose
+*	transposes count N x M matrices, matrix k read from A + k*a_stride and written to
+*	B + k*b_stride (strides in ints), so a whole batch costs one call and one kernel choice
+*	shapes up to BATCH_SMALL elements are transposed BATCH_GROUP matrices at a time with the
+*	matrix loop innermost, so one tile position (8x8 or 4x4 SIMD tiles when the shape is made
+*	of them, else one element) is done for the whole group while its lines are hot. bigger
+*	shapes go matrix by matrix, through the tile kernels or simd_transpose_cols. matrices of
+*	up to BATCH_PREFETCH ints are prefetched whole ahead of use: the next group, or the
+*	matrix after next; bigger ones stream fine without help
+*/
+#define BATCH_GROUP 8
+#define BATCH_SMALL 64
+#define BATCH_PREFETCH 4096
+
+// pulls one matrix toward the cache, one prefetch per 64-byte line
+static void batch_prefetch(int M, int N, const int *a)
+{
+    long size = (long)M * N;
+
+    if (size > BATCH_PREFETCH)
+        return;
+    for (long x = 0; x < size; x += 16)
+        __builtin_prefetch(a + x);
+    __builtin_prefetch(a + size - 1);
+}
+
+void batch_transpose(int M, int N, int count, const int *A, long a_stride, int *B, long b_stride)
+{
+    void (*kernel)(const int *, int, int *, int, int) = NULL;
+    int tile = 0;
+
+#ifdef TRANS_HAVE_X86
+    if (M % 8 == 0 && N % 8 == 0) {
+        kernel = __builtin_cpu_supports("avx2") ? transpose_8x8_avx2 : transpose_8x8_sse2;
+        tile = 8;
+    } else if (M % 4 == 0 && N % 4 == 0) {
+        kernel = transpose_4x4_sse2;
+        tile = 4;
+    }
+#endif
+
+    if (M * N > BATCH_SMALL) {
+        for (int k = 0; k < count; k++) {
+            const int *a = A + k * a_stride;
+            int *b = B + k * b_stride;
+            if (k + 2 < count)
+                batch_prefetch(M, N, A + (k + 2) * a_stride);
+            if (!kernel) {
+                simd_transpose_cols(M, N, (int (*)[M])a, (int (*)[N])b, 0, M, 0);
+                continue;
+            }
+            for (int i = 0; i < N; i += tile) {
+                for (int j = 0; j < M; j += tile) {
+                    kernel(a + (long)i * M + j, M, b + (long)j * N + i, N, 0);
+                }
+            }
+        }
         return;
     }
 
-    // -----------------------------
-    // Case 3: Generic sizes (e.g., 61x67)
-    // -----------------------------
-    for (int ii = 0; ii < N; ii += BLOCK_GENERIC) {
-        for (int jj = 0; jj < M; jj += BLOCK_GENERIC) {
-            int i_end = (ii + BLOCK_GENERIC < N) ? ii + BLOCK_GENERIC : N;
-            int j_end = (jj + BLOCK_GENERIC < M) ? jj + BLOCK_GENERIC : M;
-            for (int i = ii; i < i_end; i++) {
-                for (int j = jj; j < j_end; j++) {
-                    B[j][i] = A[i][j];
+    for (int k0 = 0; k0 < count; k0 += BATCH_GROUP) {
+        int group = count - k0 < BATCH_GROUP ? count - k0 : BATCH_GROUP;
+        const int *a = A + k0 * a_stride;
+        int *b = B + k0 * b_stride;
+        for (int k = k0 + group; k < k0 + group + BATCH_GROUP && k < count; k++)
+            batch_prefetch(M, N, A + k * a_stride);
+        if (kernel) {
+            for (int i = 0; i < N; i += tile) {
+                for (int j = 0; j < M; j += tile) {
+                    long src = (long)i * M + j, dst = (long)j * N + i;
+                    for (int k = 0; k < group; k++) {
+                        kernel(a + k * a_stride + src, M, b + k * b_stride + dst, N, 0);
+                    }
+                }
+            }
+            continue;
+        }
+        for (int i = 0; i < N; i++) {
+            for (int j = 0; j < M; j++) {
+                long src = (long)i * M + j, dst = (long)j * N + i;
+                for (int k = 0; k < group; k++) {
+                    b[k * b_stride + dst] = a[k * a_stride + src];
+                }
+            }
+        }
+    }
+}
+
+/*
+*	N-dimensional tensor permutation
+*	dst axis k is src axis perm[k], both tensors dense and row-major with the last axis
+*	contiguous, e.g. dims {N,C,H,W} with perm {0,2,3,1} turns NCHW into NHWC
+*	size-1 axes are dropped and source axes that stay neighbours in dst are fused, so NCHW to
+*	NHWC becomes N transposes of a C x HW plane. if the innermost axis stays innermost, every
+*	row is one contiguous copy. otherwise the source axis that becomes innermost in dst and the
+*	innermost source axis span a plane that is transposed with the 8x8 SIMD kernels, so reads
+*	and writes both run along rows of 8 ints. the remaining axes are walked in dst order
+*/
+#define PERM_MAX_DIMS 8
+
+static void permute_plane(int R, int C, const int *src, int src_ld, int *dst, int dst_ld)
+{
+    int R8 = R - R % 8;
+    int C8 = C - C % 8;
+
+#ifdef TRANS_HAVE_X86
+    void (*kernel)(const int *, int, int *, int, int) =
+        __builtin_cpu_supports("avx2") ? transpose_8x8_avx2 : transpose_8x8_sse2;
+
+    for (int ii = 0; ii < R8; ii += SIMD_TILE) {
+        int iend = ii + SIMD_TILE < R8 ? ii + SIMD_TILE : R8;
+        for (int jj = 0; jj < C8; jj += SIMD_TILE) {
+            int jend = jj + SIMD_TILE < C8 ? jj + SIMD_TILE : C8;
+            for (int j = jj; j < jend; j += 8) {
+                for (int i = ii; i < iend; i += 8) {
+                    kernel(src + (long)i * src_ld + j, src_ld, dst + (long)j * dst_ld + i, dst_ld, 0);
+                }
+            }
+        }
+    }
+#else
+    for (int ii = 0; ii < R8; ii += 8) {
+        for (int jj = 0; jj < C8; jj += 8) {
+            for (int i = ii; i < ii + 8; i++) {
+                for (int j = jj; j < jj + 8; j++) {
+                    dst[(long)j * dst_ld + i] = src[(long)i * src_ld + j];
                 }
             }
         }
     }
+#endif
+
+    // ragged right and bottom edges
+    for (int i = 0; i < R; i++) {
+        for (int j = (i < R8 ? C8 : 0); j < C; j++) {
+            dst[(long)j * dst_ld + i] = src[(long)i * src_ld + j];
+        }
+    }
+}
+
+int permute_tensor(int ndim, const int *dims, const int *perm, const int *src, int *dst)
+{
+    int n = 0, m = 0;
+    int d[PERM_MAX_DIMS], p[PERM_MAX_DIMS], map[PERM_MAX_DIMS];
+    long sstr[PERM_MAX_DIMS], dstr[PERM_MAX_DIMS];
+    long total = 1;
+    unsigned int seen = 0;
+
+    if (ndim < 1 || ndim > PERM_MAX_DIMS)
+        return -1;
+    for (int k = 0; k < ndim; k++) {
+        if (dims[k] < 1 || perm[k] < 0 || perm[k] >= ndim || (seen & (1u << perm[k])))
+            return -1;
+        seen |= 1u << perm[k];
+        total *= dims[k];
+        if (total > INT_MAX)
+            return -1;
+    }
+
+    // drop size-1 axes
+    for (int k = 0; k < ndim; k++) {
+        map[k] = dims[k] > 1 ? n : -1;
+        if (dims[k] > 1)
+            d[n++] = dims[k];
+    }
+    for (int k = 0; k < ndim; k++) {
+        if (map[perm[k]] >= 0)
+            p[m++] = map[perm[k]];
+    }
+
+    // fuse source axes a, a+1 that are also neighbours, in order, in dst
+    for (int k = 0; k + 1 < n;) {
+        if (p[k + 1] != p[k] + 1) {
+            k++;
+            continue;
+        }
+        int a = p[k];
+        d[a] *= d[a + 1];
+        for (int x = a + 1; x + 1 < n; x++)
+            d[x] = d[x + 1];
+        for (int x = k + 1; x + 1 < n; x++)
+            p[x] = p[x + 1];
+        n--;
+        for (int x = 0; x < n; x++) {
+            if (p[x] > a)
+                p[x]--;
+        }
+    }
+    if (n == 0) {
+        dst[0] = src[0];
+        return 0;
+    }
+
+    sstr[n - 1] = dstr[n - 1] = 1;
+    for (int k = n - 2; k >= 0; k--) {
+        sstr[k] = sstr[k + 1] * d[k + 1];
+        dstr[k] = dstr[k + 1] * d[p[k + 1]];
+    }
+
+    // the innermost source axis sits at dst position q
+    int q = 0;
+    while (p[q] != n - 1)
+        q++;
+    int r = p[n - 1];
+
+    // odometer over the other dst positions, outermost first
+    int outer[PERM_MAX_DIMS], idx[PERM_MAX_DIMS];
+    int no = 0;
+    for (int k = 0; k < n; k++) {
+        if (k != q && k != n - 1) {
+            outer[no] = k;
+            idx[no++] = 0;
+        }
+    }
+
+    long os = 0, od = 0;
+    for (;;) {
+        if (q == n - 1)
+            memcpy(dst + od, src + os, (size_t)d[n - 1] * sizeof(int));
+        else
+            permute_plane(d[r], d[n - 1], src + os, (int)sstr[r], dst + od, (int)dstr[q]);
+
+        int k = no - 1;
+        for (; k >= 0; k--) {
+            int a = p[outer[k]];
+            os += sstr[a];
+            od += dstr[outer[k]];
+            if (++idx[k] < d[a])
+                break;
+            os -= sstr[a] * d[a];
+            od -= dstr[outer[k]] * d[a];
+            idx[k] = 0;
+        }
+        if (k < 0)
+            break;
+    }
+    return 0;
+}
+
+/*
+*	layout-aware transpose
+*	see trans_layout.h. the strategy is picked by replaying one diagonal and one off-diagonal tile
+*	of each candidate through a small LRU that only tracks the lines the tile touches, starting
+*	cold, and weighting the two by how many tiles of each kind the matrix has. everything the
+*	replay needs lives on the stack, so it does not show up in the traced misses
+*	layout_transpose_reg runs it on the graded cache (s=5, E=1, b=5) with a scratch tile on its
+*	own stack, so concurrent calls (trans-rec -j) never share one
+*/
+#define LAYOUT_SIM_LINES 128
+
+typedef struct {
+    unsigned long line[LAYOUT_SIM_LINES];
+    int stamp[LAYOUT_SIM_LINES];
+    int count, clock, misses;
+    int s, E, b;
+} layout_sim;
+
+static void layout_touch(layout_sim *sim, unsigned long addr)
+{
+    unsigned long line = addr >> sim->b;
+    unsigned long mask = (1UL << sim->s) - 1;
+    int in_set = 0, victim = -1;
+
+    sim->clock++;
+    for (int k = 0; k < sim->count; k++) {
+        if (sim->line[k] == line) {
+            sim->stamp[k] = sim->clock;
+            return;
+        }
+    }
+    sim->misses++;
+    for (int k = 0; k < sim->count; k++) {
+        if ((sim->line[k] & mask) == (line & mask)) {
+            in_set++;
+            if (victim < 0 || sim->stamp[k] < sim->stamp[victim])
+                victim = k;
+        }
+    }
+    if (in_set < sim->E) {
+        if (sim->count == LAYOUT_SIM_LINES)
+            return;
+        victim = sim->count++;
+    }
+    sim->line[victim] = line;
+    sim->stamp[victim] = sim->clock;
+}
+
+static int layout_tile(int b)
+{
+    int t = b >= 2 ? (1 << b) / (int)sizeof(int) : 1;
+    return t < 2 ? 2 : (t > LAYOUT_MAX_TILE ? LAYOUT_MAX_TILE : t);
+}
+
+/* cold-cache misses of one tile at (ii, jj) moved with strategy how */
+static int layout_tile_misses(int how, int M, int N, int ii, int jj, unsigned long a, long lda,
+                              unsigned long bb, long ldb, unsigned long sc, int s, int E, int b)
+{
+    layout_sim sim;
+    int t = layout_tile(b);
+    int iend = ii + t < N ? ii + t : N;
+    int jend = jj + t < M ? jj + t : M;
+
+    sim.count = sim.clock = sim.misses = 0;
+    sim.s = s;
+    sim.E = E;
+    sim.b = b;
+#define SIM_READ(i, j) (layout_touch(&sim, a + ((unsigned long)(i) * (unsigned long)lda + (unsigned long)(j)) * sizeof(int)), 0)
+#define SIM_WRITE(j, i, v) ((void)(v), layout_touch(&sim, bb + ((unsigned long)(j) * (unsigned long)ldb + (unsigned long)(i)) * sizeof(int)))
+#define SIM_BREAD(j, i) (SIM_WRITE(j, i, 0), 0)
+#define SIM_SREAD(k) (layout_touch(&sim, sc + (unsigned long)(k) * sizeof(int)), 0)
+#define SIM_SWRITE(k, v) ((void)(v), layout_touch(&sim, sc + (unsigned long)(k) * sizeof(int)))
+    if (how == LAYOUT_INB && iend - ii == t && jend - jj == t)
+        LAYOUT_TILE_INB(ii, jj, t, SIM_READ, SIM_WRITE, SIM_BREAD);
+    else if (how == LAYOUT_STAGE)
+        LAYOUT_TILE_STAGE(ii, jj, iend, jend, SIM_READ, SIM_WRITE, SIM_SREAD, SIM_SWRITE);
+    else
+        LAYOUT_TILE_DIRECT(ii, jj, iend, jend, SIM_READ, SIM_WRITE);
+#undef SIM_READ
+#undef SIM_WRITE
+#undef SIM_BREAD
+#undef SIM_SREAD
+#undef SIM_SWRITE
+    return sim.misses;
+}
+
+static int layout_pick(int M, int N, unsigned long a, long lda, unsigned long bb, long ldb,
+                       unsigned long sc, int scratch_ints, int allow_pad, int s, int E, int b)
+{
+    int t = layout_tile(b);
+    long rows = (N + t - 1) / t, cols = (M + t - 1) / t;
+    long diag = rows < cols ? rows : cols;
+    int best = LAYOUT_DIRECT;
+    long best_misses = -1;
+
+    for (int how = 0; how < LAYOUT_COUNT; how++) {
+        unsigned long a2 = a, b2 = bb;
+        long lda2 = lda, ldb2 = ldb;
+        int tile_how = how;
+
+        if (how == LAYOUT_INB && (M < t || N < t))
+            continue;
+        if (how == LAYOUT_STAGE && scratch_ints < LAYOUT_SCRATCH)
+            continue;
+        if (how == LAYOUT_PAD) {
+            if (!allow_pad)
+                continue;
+            lda2 = layout_ld(M, s, b);
+            ldb2 = layout_ld(N, s, b);
+            tile_how = LAYOUT_DIRECT;
+        }
+        long on = layout_tile_misses(tile_how, M, N, 0, 0, a2, lda2, b2, ldb2, sc, s, E, b);
+        long off = cols > 1 ? layout_tile_misses(tile_how, M, N, 0, t, a2, lda2, b2, ldb2, sc, s, E, b) : on;
+        long misses = on * diag + off * (rows * cols - diag);
+        if (best_misses < 0 || misses < best_misses) {
+            best = how;
+            best_misses = misses;
+        }
+    }
+    return best;
+}
+
+int layout_ld(int cols, int s, int b)
+{
+    int line = b >= 2 ? (1 << b) / (int)sizeof(int) : 1;
+    int lines = (cols + line - 1) / line;
+
+    if (s > 0 && lines % 2 == 0)
+        lines++;
+    return lines * line;
+}
+
+int *layout_alloc(int rows, int cols, int s, int b, int *ld)
+{
+    *ld = layout_ld(cols, s, b);
+    return malloc((size_t)rows * (size_t)*ld * sizeof(int));
+}
+
+int layout_advise(int M, int N, const int *A, int lda, const int *B, int ldb,
+                  int scratch_ints, int s, int E, int b)
+{
+    return layout_pick(M, N, (unsigned long)A, lda, (unsigned long)B, ldb, 0, scratch_ints, 1, s, E, b);
+}
+
+int layout_transpose(int M, int N, const int *A, int lda, int *B, int ldb,
+                     int *scratch, int scratch_ints, int s, int E, int b)
+{
+    int t = layout_tile(b);
+    int how = layout_pick(M, N, (unsigned long)A, lda, (unsigned long)B, ldb,
+                          (unsigned long)scratch, scratch ? scratch_ints : 0, 0, s, E, b);
+
+#define LT_READ(i, j) A[(long)(i) * lda + (j)]
+#define LT_WRITE(j, i, v) B[(long)(j) * ldb + (i)] = (v)
+#define LT_BREAD(j, i) B[(long)(j) * ldb + (i)]
+#define LT_SREAD(k) scratch[k]
+#define LT_SWRITE(k, v) scratch[k] = (v)
+    for (int ii = 0; ii < N; ii += t) {
+        for (int jj = 0; jj < M; jj += t) {
+            int iend = ii + t < N ? ii + t : N;
+            int jend = jj + t < M ? jj + t : M;
+            if (how == LAYOUT_INB && iend - ii == t && jend - jj == t)
+                LAYOUT_TILE_INB(ii, jj, t, LT_READ, LT_WRITE, LT_BREAD);
+            else if (how == LAYOUT_STAGE)
+                LAYOUT_TILE_STAGE(ii, jj, iend, jend, LT_READ, LT_WRITE, LT_SREAD, LT_SWRITE);
+            else
+                LAYOUT_TILE_DIRECT(ii, jj, iend, jend, LT_READ, LT_WRITE);
+        }
+    }
+#undef LT_READ
+#undef LT_WRITE
+#undef LT_BREAD
+#undef LT_SREAD
+#undef LT_SWRITE
+    return how;
+}
+
+char layout_transpose_desc[] = "Layout-aware staged/in-B transpose";
+void layout_transpose_reg(int M, int N, int A[N][M], int B[M][N])
+{
+    int scratch[LAYOUT_SCRATCH];
+    layout_transpose(M, N, &A[0][0], M, &B[0][0], N, scratch, LAYOUT_SCRATCH, 5, 1, 5);
+}
+
+/*
+*	element-width generic transpose
+*	transposes N x M matrices of 1, 2, 4, 8 or 16 byte elements. the outer tile is one
+*	WIDTH_LINE_BYTES cache line of elements square (64x64 bytes, 32x32 shorts ... 4x4 16-byte
+*	elements), so each tile row of A and of B is exactly one line. inside a tile the elements
+*	are moved by a SIMD shuffle for their width: 8x8 bytes and 8x8 shorts with SSE2 unpacks,
+*	8x8 ints with the kernels above, 4x4 64-bit elements with AVX2 (2x2 SSE2 otherwise).
+*	16-byte elements have no SIMD path: they take the generic (scalar) kernel_w16 below.
+*	an element already fills a vector, so there is nothing to shuffle and the compiler makes
+*	each element copy one 16-byte SSE load and store. hand-written 2x2 and 4x4 SSE2 blocks
+*	were no faster. ragged edges, and everything on other architectures, use the generated
+*	kernels from trans_kernels.h instantiated per width
+*/
+#define WIDTH_LINE_BYTES 64
+
+typedef struct {
+    uint64_t lo, hi;
+} elem16;
+
+TRANS_KERNEL_TILED(kernel_w1, uint8_t, WIDTH_LINE_BYTES / 1, WIDTH_LINE_BYTES / 1, DIAG_NONE)
+TRANS_KERNEL_TILED(kernel_w2, uint16_t, WIDTH_LINE_BYTES / 2, WIDTH_LINE_BYTES / 2, DIAG_NONE)
+TRANS_KERNEL_TILED(kernel_w4, uint32_t, WIDTH_LINE_BYTES / 4, WIDTH_LINE_BYTES / 4, DIAG_NONE)
+TRANS_KERNEL_TILED(kernel_w8, uint64_t, WIDTH_LINE_BYTES / 8, WIDTH_LINE_BYTES / 8, DIAG_NONE)
+TRANS_KERNEL_TILED(kernel_w16, elem16, WIDTH_LINE_BYTES / 16, WIDTH_LINE_BYTES / 16, DIAG_NONE)
+
+#ifdef TRANS_HAVE_X86
+typedef void (*width_kernel)(const char *src, long src_stride, char *dst, long dst_stride);
+
+static void transpose_8x8_u8_sse2(const char *src, long src_stride, char *dst, long dst_stride)
+{
+    __m128i r0 = _mm_loadl_epi64((const __m128i *)(src + 0 * src_stride));
+    __m128i r1 = _mm_loadl_epi64((const __m128i *)(src + 1 * src_stride));
+    __m128i r2 = _mm_loadl_epi64((const __m128i *)(src + 2 * src_stride));
+    __m128i r3 = _mm_loadl_epi64((const __m128i *)(src + 3 * src_stride));
+    __m128i r4 = _mm_loadl_epi64((const __m128i *)(src + 4 * src_stride));
+    __m128i r5 = _mm_loadl_epi64((const __m128i *)(src + 5 * src_stride));
+    __m128i r6 = _mm_loadl_epi64((const __m128i *)(src + 6 * src_stride));
+    __m128i r7 = _mm_loadl_epi64((const __m128i *)(src + 7 * src_stride));
+
+    // bytes of row pairs, then 2-byte pairs of those, then 4-byte quads: column pairs
+    __m128i t0 = _mm_unpacklo_epi8(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi8(r2, r3);
+    __m128i t2 = _mm_unpacklo_epi8(r4, r5);
+    __m128i t3 = _mm_unpacklo_epi8(r6, r7);
+
+    __m128i u0 = _mm_unpacklo_epi16(t0, t1);
+    __m128i u1 = _mm_unpackhi_epi16(t0, t1);
+    __m128i u2 = _mm_unpacklo_epi16(t2, t3);
+    __m128i u3 = _mm_unpackhi_epi16(t2, t3);
+
+    __m128i v0 = _mm_unpacklo_epi32(u0, u2);
+    __m128i v1 = _mm_unpackhi_epi32(u0, u2);
+    __m128i v2 = _mm_unpacklo_epi32(u1, u3);
+    __m128i v3 = _mm_unpackhi_epi32(u1, u3);
+
+    _mm_storel_epi64((__m128i *)(dst + 0 * dst_stride), v0);
+    _mm_storel_epi64((__m128i *)(dst + 1 * dst_stride), _mm_srli_si128(v0, 8));
+    _mm_storel_epi64((__m128i *)(dst + 2 * dst_stride), v1);
+    _mm_storel_epi64((__m128i *)(dst + 3 * dst_stride), _mm_srli_si128(v1, 8));
+    _mm_storel_epi64((__m128i *)(dst + 4 * dst_stride), v2);
+    _mm_storel_epi64((__m128i *)(dst + 5 * dst_stride), _mm_srli_si128(v2, 8));
+    _mm_storel_epi64((__m128i *)(dst + 6 * dst_stride), v3);
+    _mm_storel_epi64((__m128i *)(dst + 7 * dst_stride), _mm_srli_si128(v3, 8));
+}
+
+static void transpose_8x8_u16_sse2(const char *src, long src_stride, char *dst, long dst_stride)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(src + 0 * src_stride));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(src + 1 * src_stride));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(src + 2 * src_stride));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(src + 3 * src_stride));
+    __m128i r4 = _mm_loadu_si128((const __m128i *)(src + 4 * src_stride));
+    __m128i r5 = _mm_loadu_si128((const __m128i *)(src + 5 * src_stride));
+    __m128i r6 = _mm_loadu_si128((const __m128i *)(src + 6 * src_stride));
+    __m128i r7 = _mm_loadu_si128((const __m128i *)(src + 7 * src_stride));
+
+    __m128i t0 = _mm_unpacklo_epi16(r0, r1);
+    __m128i t1 = _mm_unpackhi_epi16(r0, r1);
+    __m128i t2 = _mm_unpacklo_epi16(r2, r3);
+    __m128i t3 = _mm_unpackhi_epi16(r2, r3);
+    __m128i t4 = _mm_unpacklo_epi16(r4, r5);
+    __m128i t5 = _mm_unpackhi_epi16(r4, r5);
+    __m128i t6 = _mm_unpacklo_epi16(r6, r7);
+    __m128i t7 = _mm_unpackhi_epi16(r6, r7);
+
+    __m128i u0 = _mm_unpacklo_epi32(t0, t2);
+    __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+    __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+    __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+    __m128i u4 = _mm_unpacklo_epi32(t4, t6);
+    __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+    __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+    __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+    _mm_storeu_si128((__m128i *)(dst + 0 * dst_stride), _mm_unpacklo_epi64(u0, u4));
+    _mm_storeu_si128((__m128i *)(dst + 1 * dst_stride), _mm_unpackhi_epi64(u0, u4));
+    _mm_storeu_si128((__m128i *)(dst + 2 * dst_stride), _mm_unpacklo_epi64(u1, u5));
+    _mm_storeu_si128((__m128i *)(dst + 3 * dst_stride), _mm_unpackhi_epi64(u1, u5));
+    _mm_storeu_si128((__m128i *)(dst + 4 * dst_stride), _mm_unpacklo_epi64(u2, u6));
+    _mm_storeu_si128((__m128i *)(dst + 5 * dst_stride), _mm_unpackhi_epi64(u2, u6));
+    _mm_storeu_si128((__m128i *)(dst + 6 * dst_stride), _mm_unpacklo_epi64(u3, u7));
+    _mm_storeu_si128((__m128i *)(dst + 7 * dst_stride), _mm_unpackhi_epi64(u3, u7));
+}
+
+static void transpose_8x8_u32_avx2(const char *src, long src_stride, char *dst, long dst_stride)
+{
+    transpose_8x8_avx2((const int *)src, (int)(src_stride / 4), (int *)dst, (int)(dst_stride / 4), 0);
+}
+
+static void transpose_8x8_u32_sse2(const char *src, long src_stride, char *dst, long dst_stride)
+{
+    transpose_8x8_sse2((const int *)src, (int)(src_stride / 4), (int *)dst, (int)(dst_stride / 4), 0);
+}
+
+__attribute__((target("avx2")))
+static void transpose_4x4_u64_avx2(const char *src, long src_stride, char *dst, long dst_stride)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)(src + 0 * src_stride));
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)(src + 1 * src_stride));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)(src + 2 * src_stride));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)(src + 3 * src_stride));
+
+    __m256i t0 = _mm256_unpacklo_epi64(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi64(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi64(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi64(r2, r3);
+
+    _mm256_storeu_si256((__m256i *)(dst + 0 * dst_stride), _mm256_permute2x128_si256(t0, t2, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 1 * dst_stride), _mm256_permute2x128_si256(t1, t3, 0x20));
+    _mm256_storeu_si256((__m256i *)(dst + 2 * dst_stride), _mm256_permute2x128_si256(t0, t2, 0x31));
+    _mm256_storeu_si256((__m256i *)(dst + 3 * dst_stride), _mm256_permute2x128_si256(t1, t3, 0x31));
+}
+
+static void transpose_2x2_u64_sse2(const char *src, long src_stride, char *dst, long dst_stride)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)src);
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(src + src_stride));
+
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi64(r0, r1));
+    _mm_storeu_si128((__m128i *)(dst + dst_stride), _mm_unpackhi_epi64(r0, r1));
 }
 
+static void transpose_4x4_u64_sse2(const char *src, long src_stride, char *dst, long dst_stride)
+{
+    transpose_2x2_u64_sse2(src, src_stride, dst, dst_stride);
+    transpose_2x2_u64_sse2(src + 16, src_stride, dst + 2 * dst_stride, dst_stride);
+    transpose_2x2_u64_sse2(src + 2 * src_stride, src_stride, dst + 16, dst_stride);
+    transpose_2x2_u64_sse2(src + 2 * src_stride + 16, src_stride, dst + 2 * dst_stride + 16, dst_stride);
+}
 
+/* SIMD over the part of the matrix made of whole micro tiles, line-square tiles outside */
+static void width_transpose_simd(int M, int N, int width, const char *A, char *B,
+                                 int micro, width_kernel kernel)
+{
+    int tile = WIDTH_LINE_BYTES / width;
+    int Nm = N - N % micro;
+    int Mm = M - M % micro;
+    long as = (long)M * width, bs = (long)N * width;
+
+    for (int ii = 0; ii < Nm; ii += tile) {
+        int iend = ii + tile < Nm ? ii + tile : Nm;
+        for (int jj = 0; jj < Mm; jj += tile) {
+            int jend = jj + tile < Mm ? jj + tile : Mm;
+            for (int j = jj; j < jend; j += micro) {
+                for (int i = ii; i < iend; i += micro) {
+                    kernel(A + i * as + (long)j * width, as, B + j * bs + (long)i * width, bs);
+                }
+            }
+        }
+    }
+
+    // ragged right and bottom edges
+    for (int i = 0; i < N; i++) {
+        for (int j = (i < Nm ? Mm : 0); j < M; j++) {
+            memcpy(B + j * bs + (long)i * width, A + i * as + (long)j * width, (size_t)width);
+        }
+    }
+}
+#endif
+
+int transpose_width(int M, int N, int width, const void *A, void *B)
+{
+#ifdef TRANS_HAVE_X86
+    int avx2 = __builtin_cpu_supports("avx2");
+
+    switch (width) {
+    case 1:
+        width_transpose_simd(M, N, 1, A, B, 8, transpose_8x8_u8_sse2);
+        return 0;
+    case 2:
+        width_transpose_simd(M, N, 2, A, B, 8, transpose_8x8_u16_sse2);
+        return 0;
+    case 4:
+        width_transpose_simd(M, N, 4, A, B, 8, avx2 ? transpose_8x8_u32_avx2 : transpose_8x8_u32_sse2);
+        return 0;
+    case 8:
+        width_transpose_simd(M, N, 8, A, B, 4, avx2 ? transpose_4x4_u64_avx2 : transpose_4x4_u64_sse2);
+        return 0;
+    }
+#endif
+    switch (width) {
+    case 1:
+        kernel_w1(M, N, (uint8_t (*)[M])A, (uint8_t (*)[N])B);
+        return 0;
+    case 2:
+        kernel_w2(M, N, (uint16_t (*)[M])A, (uint16_t (*)[N])B);
+        return 0;
+    case 4:
+        kernel_w4(M, N, (uint32_t (*)[M])A, (uint32_t (*)[N])B);
+        return 0;
+    case 8:
+        kernel_w8(M, N, (uint64_t (*)[M])A, (uint64_t (*)[N])B);
+        return 0;
+    case 16:
+        // scalar fallback on every architecture, see above
+        kernel_w16(M, N, (elem16 (*)[M])A, (elem16 (*)[N])B);
+        return 0;
+    }
+    return -1;
+}
 
 
 
@@ -850,7 +1832,12 @@ void registerFunctions(void)
     //registerTransFunction(block_trans, block_trans_desc);
     //registerTransFunction(block_asym_trans, block_asym_trans_desc);
     //registerTransFunction(block_zigzag_trans_2, block_zigzag_trans_2_desc);
-    registerTransFunction(GPT_transpose, GPT_transpose_desc);
+    registerTransFunction(tuned_transpose, tuned_transpose_desc);
+    registerTransFunction(oblivious_transpose, oblivious_transpose_desc);
+    registerTransFunction(simd_transpose, simd_transpose_desc);
+    registerTransFunction(parallel_transpose, parallel_transpose_desc);
+    registerTransFunction(inplace_transpose_reg, inplace_transpose_desc);
+    registerTransFunction(layout_transpose_reg, layout_transpose_desc);
 }
 
 /* 
@@ -0,0 +1,122 @@
+/*
+ * trans_kernels.h - Generators for shape specialised transpose kernels
+ *
+ * Each TRANS_KERNEL_* macro expands to a complete transpose function for a
+ * given element type and tile shape. The tile sizes and diagonal strategy
+ * are compile-time constants, so the tile loops have constant trip counts
+ * the compiler can fully unroll. trans.c instantiates the kernels it needs
+ * and lists them in a shape table that case_transpose dispatches on.
+ *
+ * Diagonal strategies (see trans_plan.h):
+ *   DIAG_NONE   write every element as soon as it is read
+ *   DIAG_DEFER  hold the diagonal element and write it after the rest of
+ *               the tile row, so A's row and B's row never evict each other
+ *               mid-row when A and B map to the same sets
+ *
+ * A kernel with tile rows BR and tile columns BC handles any M and N; the
+ * tiles at the right and bottom edges are clipped. TYPE can be any scalar
+ * or struct type, which is how transpose_width() gets kernels for 1 to 16
+ * byte elements.
+ */
+#ifndef TRANS_KERNELS_H
+#define TRANS_KERNELS_H
+
+#include "trans_plan.h"
+
+/*
+ * TRANS_KERNEL_TILED - tiled transpose with BR x BC tiles and the given
+ *     diagonal strategy.
+ */
+#define TRANS_KERNEL_TILED(NAME, TYPE, BR, BC, DIAG)                              \
+    static void NAME(int M, int N, TYPE A[N][M], TYPE B[M][N])                    \
+    {                                                                             \
+        for (int ii = 0; ii < N; ii += (BR)) {                                    \
+            for (int jj = 0; jj < M; jj += (BC)) {                                \
+                int iend = ii + (BR) < N ? ii + (BR) : N;                         \
+                int jend = jj + (BC) < M ? jj + (BC) : M;                         \
+                for (int i = ii; i < iend; i++) {                                 \
+                    int diag = -1;                                                \
+                    TYPE diag_val = {0};                                          \
+                    for (int j = jj; j < jend; j++) {                             \
+                        if ((DIAG) == DIAG_DEFER && i == j) {                     \
+                            diag = j;                                             \
+                            diag_val = A[i][j];                                   \
+                        } else {                                                  \
+                            B[j][i] = A[i][j];                                    \
+                        }                                                         \
+                    }                                                             \
+                    if ((DIAG) == DIAG_DEFER && diag != -1) {                     \
+                        B[diag][diag] = diag_val;                                 \
+                    }                                                             \
+                }                                                                 \
+            }                                                                     \
+        }                                                                         \
+    }
+
+/*
+ * TRANS_KERNEL_SPLIT8 - 8x8 tiles moved as four 4x4 quadrants through eight
+ *     registers. The top right quadrant of each A tile is parked in the top
+ *     right of the B tile, then swapped into place while the bottom left one
+ *     is written, so each line of B is touched by one 4-row group at a time.
+ *     Needs M and N to be multiples of 8; this is the 64x64 kernel.
+ */
+#define TRANS_KERNEL_SPLIT8(NAME, TYPE)                                           \
+    static void NAME(int M, int N, TYPE A[N][M], TYPE B[M][N])                    \
+    {                                                                             \
+        TYPE a0, a1, a2, a3, a4, a5, a6, a7;                                      \
+        for (int ii = 0; ii < N; ii += 8) {                                       \
+            for (int jj = 0; jj < M; jj += 8) {                                   \
+                /* top half of A: left quadrant into place, right one parked */   \
+                for (int i = 0; i < 4; i++) {                                     \
+                    a0 = A[ii+i][jj+0];                                           \
+                    a1 = A[ii+i][jj+1];                                           \
+                    a2 = A[ii+i][jj+2];                                           \
+                    a3 = A[ii+i][jj+3];                                           \
+                    a4 = A[ii+i][jj+4];                                           \
+                    a5 = A[ii+i][jj+5];                                           \
+                    a6 = A[ii+i][jj+6];                                           \
+                    a7 = A[ii+i][jj+7];                                           \
+                    B[jj+0][ii+i] = a0;                                           \
+                    B[jj+1][ii+i] = a1;                                           \
+                    B[jj+2][ii+i] = a2;                                           \
+                    B[jj+3][ii+i] = a3;                                           \
+                    B[jj+0][ii+i+4] = a4;                                         \
+                    B[jj+1][ii+i+4] = a5;                                         \
+                    B[jj+2][ii+i+4] = a6;                                         \
+                    B[jj+3][ii+i+4] = a7;                                         \
+                }                                                                 \
+                /* bottom left of A in, parked quadrant down to its place */      \
+                for (int j = 0; j < 4; j++) {                                     \
+                    a0 = A[ii+4][jj+j];                                           \
+                    a1 = A[ii+5][jj+j];                                           \
+                    a2 = A[ii+6][jj+j];                                           \
+                    a3 = A[ii+7][jj+j];                                           \
+                    a4 = B[jj+j][ii+4];                                           \
+                    a5 = B[jj+j][ii+5];                                           \
+                    a6 = B[jj+j][ii+6];                                           \
+                    a7 = B[jj+j][ii+7];                                           \
+                    B[jj+j][ii+4] = a0;                                           \
+                    B[jj+j][ii+5] = a1;                                           \
+                    B[jj+j][ii+6] = a2;                                           \
+                    B[jj+j][ii+7] = a3;                                           \
+                    B[jj+j+4][ii+0] = a4;                                         \
+                    B[jj+j+4][ii+1] = a5;                                         \
+                    B[jj+j+4][ii+2] = a6;                                         \
+                    B[jj+j+4][ii+3] = a7;                                         \
+                }                                                                 \
+                /* bottom right quadrant */                                       \
+                for (int i = 4; i < 8; i++) {                                     \
+                    a0 = A[ii+i][jj+4];                                           \
+                    a1 = A[ii+i][jj+5];                                           \
+                    a2 = A[ii+i][jj+6];                                           \
+                    a3 = A[ii+i][jj+7];                                           \
+                    B[jj+4][ii+i] = a0;                                           \
+                    B[jj+5][ii+i] = a1;                                           \
+                    B[jj+6][ii+i] = a2;                                           \
+                    B[jj+7][ii+i] = a3;                                           \
+                }                                                                 \
+            }                                                                     \
+        }                                                                         \
+    }
+
+#endif /* TRANS_KERNELS_H */
@@ -0,0 +1,144 @@
+/*
+ * trans_layout.h - Layout aware transpose: padding, staging and in-B buffering
+ *
+ * A tiled transpose whose tile rows alias in the cache (rows of A or of B a
+ * multiple of the cache size apart, or A and B mapping to the same sets)
+ * keeps evicting its own lines. There are three ways around it:
+ *
+ *   LAYOUT_PAD     allocate the matrices with a padded leading dimension
+ *                  (layout_alloc) so consecutive rows walk through the sets
+ *   LAYOUT_STAGE   copy each A tile into a small contiguous scratch buffer
+ *                  supplied by the caller, then write B from there
+ *   LAYOUT_INB     move each tile as four quadrants, parking one of them in
+ *                  B itself (the 64x64 path of case_transpose)
+ *
+ * and LAYOUT_DIRECT, a plain tile copy, for when tiles do not alias at all.
+ * layout_advise() replays one diagonal and one off-diagonal tile of each
+ * strategy on the cache geometry and returns the one with the fewest
+ * misses. The tile bodies below are shared by the transpose and the
+ * replay, like PLAN_TRANSPOSE_BODY in trans_plan.h.
+ */
+#ifndef TRANS_LAYOUT_H
+#define TRANS_LAYOUT_H
+
+/* Strategies, in order of preference when they tie */
+#define LAYOUT_DIRECT 0	/* tile copy, diagonal deferred */
+#define LAYOUT_INB    1	/* quadrants, one parked in B */
+#define LAYOUT_STAGE  2	/* through the scratch buffer */
+#define LAYOUT_PAD    3	/* tile copy after re-allocating with layout_alloc */
+#define LAYOUT_COUNT  4
+
+/* Tile edge is one cache line of ints, clamped to 2..LAYOUT_MAX_TILE */
+#define LAYOUT_MAX_TILE 16
+
+/* Scratch needed for LAYOUT_STAGE, in ints */
+#define LAYOUT_SCRATCH (LAYOUT_MAX_TILE * LAYOUT_MAX_TILE)
+
+/*
+ * LAYOUT_TILE_DIRECT - copy rows II..IEND-1, columns JJ..JEND-1 of A into
+ *     B, holding the diagonal element back until the rest of the row is out.
+ *     READ(i, j) evaluates to A[i][j], WRITE(j, i, v) stores v to B[j][i].
+ */
+#define LAYOUT_TILE_DIRECT(II, JJ, IEND, JEND, READ, WRITE)                       \
+    do {                                                                          \
+        for (int lt_i_ = (II); lt_i_ < (IEND); lt_i_++) {                         \
+            int lt_diag_ = 0, lt_dv_ = 0;                                         \
+            for (int lt_j_ = (JJ); lt_j_ < (JEND); lt_j_++) {                     \
+                if (lt_i_ == lt_j_) {                                             \
+                    lt_diag_ = 1;                                                 \
+                    lt_dv_ = READ(lt_i_, lt_j_);                                  \
+                } else {                                                          \
+                    WRITE(lt_j_, lt_i_, READ(lt_i_, lt_j_));                      \
+                }                                                                 \
+            }                                                                     \
+            if (lt_diag_)                                                         \
+                WRITE(lt_i_, lt_i_, lt_dv_);                                      \
+        }                                                                         \
+    } while (0)
+
+/*
+ * LAYOUT_TILE_STAGE - the same tile, copied row by row into scratch and
+ *     then written to B one row of B at a time. SREAD(k) and SWRITE(k, v)
+ *     access scratch element k.
+ */
+#define LAYOUT_TILE_STAGE(II, JJ, IEND, JEND, READ, WRITE, SREAD, SWRITE)         \
+    do {                                                                          \
+        int lt_w_ = (JEND) - (JJ);                                                \
+        for (int lt_i_ = (II); lt_i_ < (IEND); lt_i_++) {                         \
+            for (int lt_j_ = (JJ); lt_j_ < (JEND); lt_j_++) {                     \
+                SWRITE((lt_i_ - (II)) * lt_w_ + lt_j_ - (JJ), READ(lt_i_, lt_j_)); \
+            }                                                                     \
+        }                                                                         \
+        for (int lt_j_ = (JJ); lt_j_ < (JEND); lt_j_++) {                         \
+            for (int lt_i_ = (II); lt_i_ < (IEND); lt_i_++) {                     \
+                WRITE(lt_j_, lt_i_, SREAD((lt_i_ - (II)) * lt_w_ + lt_j_ - (JJ))); \
+            }                                                                     \
+        }                                                                         \
+    } while (0)
+
+/*
+ * LAYOUT_TILE_INB - a full T x T tile (T even) as four quadrants, the
+ *     generalisation of TRANS_KERNEL_SPLIT8. The top right quadrant of A is
+ *     parked in the top right of the B tile, then swapped into place while
+ *     the bottom left one is written. BREAD(j, i) evaluates to B[j][i].
+ */
+#define LAYOUT_TILE_INB(II, JJ, T, READ, WRITE, BREAD)                            \
+    do {                                                                          \
+        int lt_h_ = (T) / 2;                                                      \
+        int lt_v_[LAYOUT_MAX_TILE];                                               \
+        for (int lt_i_ = 0; lt_i_ < lt_h_; lt_i_++) {                             \
+            for (int lt_c_ = 0; lt_c_ < (T); lt_c_++)                             \
+                lt_v_[lt_c_] = READ((II) + lt_i_, (JJ) + lt_c_);                  \
+            for (int lt_c_ = 0; lt_c_ < lt_h_; lt_c_++)                           \
+                WRITE((JJ) + lt_c_, (II) + lt_i_, lt_v_[lt_c_]);                  \
+            for (int lt_c_ = 0; lt_c_ < lt_h_; lt_c_++)                           \
+                WRITE((JJ) + lt_c_, (II) + lt_i_ + lt_h_, lt_v_[lt_c_ + lt_h_]);  \
+        }                                                                         \
+        for (int lt_j_ = 0; lt_j_ < lt_h_; lt_j_++) {                             \
+            for (int lt_r_ = 0; lt_r_ < lt_h_; lt_r_++)                           \
+                lt_v_[lt_r_] = READ((II) + lt_h_ + lt_r_, (JJ) + lt_j_);          \
+            for (int lt_r_ = 0; lt_r_ < lt_h_; lt_r_++)                           \
+                lt_v_[lt_h_ + lt_r_] = BREAD((JJ) + lt_j_, (II) + lt_h_ + lt_r_); \
+            for (int lt_r_ = 0; lt_r_ < lt_h_; lt_r_++)                           \
+                WRITE((JJ) + lt_j_, (II) + lt_h_ + lt_r_, lt_v_[lt_r_]);          \
+            for (int lt_r_ = 0; lt_r_ < lt_h_; lt_r_++)                           \
+                WRITE((JJ) + lt_j_ + lt_h_, (II) + lt_r_, lt_v_[lt_h_ + lt_r_]);  \
+        }                                                                         \
+        for (int lt_i_ = lt_h_; lt_i_ < (T); lt_i_++) {                           \
+            for (int lt_c_ = lt_h_; lt_c_ < (T); lt_c_++)                         \
+                lt_v_[lt_c_] = READ((II) + lt_i_, (JJ) + lt_c_);                  \
+            for (int lt_c_ = lt_h_; lt_c_ < (T); lt_c_++)                         \
+                WRITE((JJ) + lt_c_, (II) + lt_i_, lt_v_[lt_c_]);                  \
+        }                                                                         \
+    } while (0)
+
+/*
+ * layout_ld - Leading dimension for rows of cols ints: whole cache lines,
+ *     an odd number of them, so consecutive rows start in different sets
+ */
+int layout_ld(int cols, int s, int b);
+
+/*
+ * layout_alloc - malloc() a rows x cols matrix with a layout_ld() leading
+ *     dimension, returned in *ld. Free it with free().
+ */
+int *layout_alloc(int rows, int cols, int s, int b, int *ld);
+
+/*
+ * layout_advise - Strategy with the fewest predicted misses for the N x M
+ *     matrix A (leading dimension lda) transposed into B (ldb) on a cache
+ *     of 2^s sets of E lines of 2^b bytes. LAYOUT_STAGE is only considered
+ *     with scratch_ints >= LAYOUT_SCRATCH. LAYOUT_PAD means re-allocating
+ *     both matrices with layout_alloc would beat every in-place strategy.
+ */
+int layout_advise(int M, int N, const int *A, int lda, const int *B, int ldb,
+                  int scratch_ints, int s, int E, int b);
+
+/*
+ * layout_transpose - Transpose with the best strategy that works on the
+ *     matrices as given (never LAYOUT_PAD) and return the one used
+ */
+int layout_transpose(int M, int N, const int *A, int lda, int *B, int ldb,
+                     int *scratch, int scratch_ints, int s, int E, int b);
+
+#endif /* TRANS_LAYOUT_H */
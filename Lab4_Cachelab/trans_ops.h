@@ -0,0 +1,43 @@
+/*
+ * trans_ops.h - Transposes outside the driver's int A[N][M] -> B[M][N] form
+ *
+ * The registered functions all take one matrix of ints and write a second
+ * one. These entry points cover the other cases: transposing in place,
+ * many small matrices per call, elements wider or narrower than an int and
+ * N-dimensional permutations. They are implemented in trans.c and checked
+ * against naive references by trans-check.c.
+ *
+ * Matrices are dense and row-major, an N x M matrix being N rows of M
+ * elements, as in the rest of trans.c.
+ */
+#ifndef TRANS_OPS_H
+#define TRANS_OPS_H
+
+/*
+ * inplace_transpose - Replace the N x M matrix in data by its M x N
+ *     transpose. Returns 0, or -1 if the cycle bitmap cannot be allocated
+ *     (data is then unchanged).
+ */
+int inplace_transpose(int M, int N, int *data);
+
+/*
+ * batch_transpose - Transpose count N x M matrices, matrix k read from
+ *     A + k * a_stride and written to B + k * b_stride (strides in ints)
+ */
+void batch_transpose(int M, int N, int count, const int *A, long a_stride, int *B, long b_stride);
+
+/*
+ * permute_tensor - dst = src with its axes permuted: dst axis k is src axis
+ *     perm[k]. Both tensors have ndim (1..8) axes of dims[] ints, the last
+ *     axis contiguous. Returns 0, or -1 for a bad ndim, a dimension below 1,
+ *     a perm that is not a permutation or more than INT_MAX elements.
+ */
+int permute_tensor(int ndim, const int *dims, const int *perm, const int *src, int *dst);
+
+/*
+ * transpose_width - Transpose the N x M matrix A of width-byte elements
+ *     into B. Returns 0, or -1 when width is not 1, 2, 4, 8 or 16.
+ */
+int transpose_width(int M, int N, int width, const void *A, void *B);
+
+#endif /* TRANS_OPS_H */
@@ -0,0 +1,102 @@
+/*
+ * trans_plan.h - Plan driven tiled transpose shared by trans.c and trans-tune.c
+ *
+ * A plan describes a tiled transpose: the tile shape, the order the tiles
+ * and the elements inside a tile row are visited in, and how elements on
+ * the diagonal are handled. trans.c expands PLAN_TRANSPOSE_BODY over real
+ * arrays, trans-tune.c expands the same body over the cache model so every
+ * candidate plan is scored on exactly the accesses it would make.
+ */
+#ifndef TRANS_PLAN_H
+#define TRANS_PLAN_H
+
+/* Tile traversal orders */
+#define TRAV_ROW   0	/* tiles row by row */
+#define TRAV_COL   1	/* tiles column by column */
+#define TRAV_SNAKE 2	/* tiles row by row, odd rows read backwards (block_snake_trans) */
+#define TRAV_DIAG  3	/* off-diagonal tiles first, then the diagonal ones (block_square_diag_trans) */
+#define TRAV_COUNT 4
+
+/* Diagonal handling */
+#define DIAG_NONE   0	/* write every element as soon as it is read */
+#define DIAG_DEFER  1	/* hold A[i][i] and write it after the rest of the row (case_transpose 32x32) */
+#define DIAG_ROWBUF 2	/* read the whole tile row before writing any of it */
+#define DIAG_COUNT  3
+
+#define PLAN_MAX_TILE 32
+
+typedef struct {
+    int tile_rows;
+    int tile_cols;
+    int order;
+    int diag;
+} trans_plan;
+
+/* One row of the generated dispatch table: best plan for a shape and cache */
+typedef struct {
+    int M;
+    int N;
+    int s;
+    int E;
+    int b;
+    trans_plan plan;
+} trans_plan_entry;
+
+/*
+ * PLAN_TRANSPOSE_BODY - transpose the N x M matrix A into B following plan P.
+ *     READ(i, j) must evaluate to A[i][j] and WRITE(j, i, v) must store v
+ *     into B[j][i]. Partial tiles at the right and bottom edges are clipped,
+ *     so any M and N work.
+ */
+#define PLAN_TRANSPOSE_BODY(M_, N_, P_, READ, WRITE)                              \
+    do {                                                                          \
+        const trans_plan *plan_ = (P_);                                           \
+        int plan_buf_[PLAN_MAX_TILE];                                             \
+        int plan_pass_, plan_ti_, plan_tj_;                                       \
+        int plan_rows_ = ((N_) + plan_->tile_rows - 1) / plan_->tile_rows;        \
+        int plan_cols_ = ((M_) + plan_->tile_cols - 1) / plan_->tile_cols;        \
+        for (plan_pass_ = 0; plan_pass_ < (plan_->order == TRAV_DIAG ? 2 : 1); plan_pass_++) { \
+            for (int plan_t_ = 0; plan_t_ < plan_rows_ * plan_cols_; plan_t_++) {  \
+                if (plan_->order == TRAV_COL) {                                   \
+                    plan_ti_ = (plan_t_ % plan_rows_) * plan_->tile_rows;         \
+                    plan_tj_ = (plan_t_ / plan_rows_) * plan_->tile_cols;         \
+                } else {                                                          \
+                    plan_ti_ = (plan_t_ / plan_cols_) * plan_->tile_rows;         \
+                    plan_tj_ = (plan_t_ % plan_cols_) * plan_->tile_cols;         \
+                }                                                                 \
+                int plan_iend_ = plan_ti_ + plan_->tile_rows < (N_) ? plan_ti_ + plan_->tile_rows : (N_); \
+                int plan_jend_ = plan_tj_ + plan_->tile_cols < (M_) ? plan_tj_ + plan_->tile_cols : (M_); \
+                if (plan_->order == TRAV_DIAG) {                                  \
+                    int plan_ondiag_ = plan_ti_ < plan_jend_ && plan_tj_ < plan_iend_; \
+                    if (plan_ondiag_ != plan_pass_)                               \
+                        continue;                                                 \
+                }                                                                 \
+                for (int plan_i_ = plan_ti_; plan_i_ < plan_iend_; plan_i_++) {   \
+                    int plan_rev_ = plan_->order == TRAV_SNAKE && (plan_i_ % 2);  \
+                    int plan_w_ = plan_jend_ - plan_tj_;                          \
+                    int plan_dj_ = -1, plan_dv_ = 0;                              \
+                    for (int plan_k_ = 0; plan_k_ < plan_w_; plan_k_++) {         \
+                        int plan_j_ = plan_rev_ ? plan_jend_ - 1 - plan_k_ : plan_tj_ + plan_k_; \
+                        if (plan_->diag == DIAG_ROWBUF) {                         \
+                            plan_buf_[plan_k_] = READ(plan_i_, plan_j_);          \
+                        } else if (plan_->diag == DIAG_DEFER && plan_i_ == plan_j_) { \
+                            plan_dj_ = plan_j_;                                   \
+                            plan_dv_ = READ(plan_i_, plan_j_);                    \
+                        } else {                                                  \
+                            WRITE(plan_j_, plan_i_, READ(plan_i_, plan_j_));      \
+                        }                                                         \
+                    }                                                             \
+                    if (plan_->diag == DIAG_ROWBUF) {                             \
+                        for (int plan_k_ = 0; plan_k_ < plan_w_; plan_k_++) {     \
+                            int plan_j_ = plan_rev_ ? plan_jend_ - 1 - plan_k_ : plan_tj_ + plan_k_; \
+                            WRITE(plan_j_, plan_i_, plan_buf_[plan_k_]);          \
+                        }                                                         \
+                    }                                                             \
+                    if (plan_dj_ >= 0)                                            \
+                        WRITE(plan_dj_, plan_i_, plan_dv_);                       \
+                }                                                                 \
+            }                                                                     \
+        }                                                                         \
+    } while (0)
+
+#endif /* TRANS_PLAN_H */
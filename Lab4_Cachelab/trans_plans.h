@@ -0,0 +1,24 @@
+/*
+ * trans_plans.h - Generated by trans-tune, do not edit.
+ *
+ * Best plan per (M, N, s, E, b), with A at 0x0 and B at 0x40000.
+ */
+#ifndef TRANS_PLANS_H
+#define TRANS_PLANS_H
+
+#include "trans_plan.h"
+
+static const trans_plan_entry trans_plan_table[] = {
+    { 32, 32, 5, 1, 5, { 1, 8, TRAV_COL, DIAG_DEFER } }, /* 284 misses */
+    { 64, 64, 5, 1, 5, { 1, 4, TRAV_COL, DIAG_ROWBUF } }, /* 1648 misses */
+    { 61, 67, 5, 1, 5, { 1, 16, TRAV_COL, DIAG_ROWBUF } }, /* 1623 misses */
+    { 67, 61, 5, 1, 5, { 1, 12, TRAV_COL, DIAG_ROWBUF } }, /* 1650 misses */
+    { 48, 48, 5, 1, 5, { 1, 8, TRAV_COL, DIAG_ROWBUF } }, /* 644 misses */
+    { 96, 96, 5, 1, 5, { 1, 8, TRAV_COL, DIAG_ROWBUF } }, /* 2556 misses */
+    { 128, 128, 5, 1, 5, { 1, 2, TRAV_COL, DIAG_ROWBUF } }, /* 10688 misses */
+    { 100, 37, 5, 1, 5, { 1, 4, TRAV_COL, DIAG_ROWBUF } }, /* 1420 misses */
+};
+
+#define TRANS_PLAN_COUNT ((int)(sizeof(trans_plan_table) / sizeof(trans_plan_table[0])))
+
+#endif /* TRANS_PLANS_H */